@@ -0,0 +1,165 @@
+// Time the rope of TextBuffer against reading QTextDocument::toPlainText(), on a generated text.
+// Built with -DNEVERJUDGE_BUILD_BENCHMARKS=ON, run as: buffer_bench [lines]
+
+#include <QElapsedTimer>
+#include <QGuiApplication>
+#include <QRandomGenerator>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTextStream>
+#include <functional>
+
+#include "../ide/buffer.h"
+
+#define DEFAULT_LINES 50000
+
+static QTextStream out(stdout);
+// the results are summed in here, so the compiler cannot drop the work measured
+static qint64 sink = 0;
+
+/** The time of one run of fn in µs, the mean of the runs */
+static double measure(int runs, const std::function<void(int run)> &fn) {
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < runs; ++i) {
+        fn(i);
+    }
+    return static_cast<double>(timer.nsecsElapsed()) / runs / 1000;
+}
+
+static void report(const QString &name, double before, double after) {
+    out << qSetFieldWidth(36) << Qt::left << name << qSetFieldWidth(14) << Qt::right
+        << QString::number(before, 'f', 2) << QString::number(after, 'f', 2)
+        << QString::number(before / after, 'f', 1) + "x" << qSetFieldWidth(0) << '\n';
+    out.flush();
+}
+
+/** Lines of code of varied length, some of them not ASCII */
+static QString generate(int lines) {
+    static const QStringList samples = {
+            "int main() {",
+            "    std::vector<int> values(n, 0);",
+            "    for (int i = 0; i < n; ++i) {",
+            "        values[i] = read(i) * 2 + 1; // 输入的值",
+            "    }",
+            "    return std::accumulate(values.begin(), values.end(), 0);",
+            "}",
+            "",
+    };
+    QString text;
+    for (int i = 0; i < lines; ++i) {
+        text += samples[i % samples.size()];
+        if (i + 1 < lines) {
+            text += '\n';
+        }
+    }
+    return text;
+}
+
+int main(int argc, char *argv[]) {
+    // QTextDocument needs a GUI application, but no screen
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QGuiApplication app(argc, argv);
+    int lines = argc > 1 ? QString(argv[1]).toInt() : DEFAULT_LINES;
+    QString text = generate(lines);
+
+    // the same text, with and without the rope attached
+    QTextDocument plain;
+    plain.setPlainText(text);
+    QTextDocument doc;
+    doc.setPlainText(text);
+    TextBuffer *buffer = TextBuffer::of(&doc);
+    buffer->flush();
+
+    auto *random = QRandomGenerator::global();
+    qsizetype length = buffer->snapshot().length();
+    QList<qsizetype> offsets;
+    QList<int> lineNumbers;
+    for (int i = 0; i < 10000; ++i) {
+        offsets.append(random->bounded(length));
+        lineNumbers.append(random->bounded(lines));
+    }
+
+    out << lines << " lines, " << length << " characters\n";
+    out << qSetFieldWidth(36) << Qt::left << "µs per run" << qSetFieldWidth(14) << Qt::right
+        << "toPlainText" << "rope" << "speedup" << qSetFieldWidth(0) << '\n';
+
+    // what the highlighter, the LSP and the save read before the rope
+    double before = measure(50, [&](int) { sink += plain.toPlainText().toUtf8().size(); });
+    double after = measure(50, [&](int) { sink += buffer->snapshot().toUtf8().size(); });
+    report("whole text as UTF-8", before, after);
+
+    before = measure(50, [&](int) { sink += plain.toPlainText().size(); });
+    after = measure(50, [&](int) {
+        TextSnapshot copy = buffer->snapshot();
+        sink += copy.length();
+    });
+    report("snapshot and copy", before, after);
+
+    // a keystroke in the middle, then the text is read again
+    auto type = [&](QTextDocument &document, int run) {
+        QTextCursor cursor(&document);
+        cursor.setPosition(static_cast<int>(length / 2));
+        if (run % 2 == 0) {
+            cursor.insertText("x");
+        } else {
+            cursor.deletePreviousChar();
+        }
+    };
+    before = measure(200, [&](int run) {
+        type(plain, run);
+        sink += plain.toPlainText().size();
+    });
+    after = measure(200, [&](int run) {
+        type(doc, run);
+        buffer->flush();
+        sink += buffer->snapshot().length();
+    });
+    report("keystroke then snapshot", before, after);
+
+    // the text is read once, as the callers did, then scanned for each position
+    QString copied = plain.toPlainText();
+    TextSnapshot snapshot = buffer->snapshot();
+    before = measure(200, [&](int run) {
+        auto head = QStringView(copied).first(offsets[run]);
+        sink += head.count('\n') + head.size() - head.lastIndexOf('\n') - 1;
+    });
+    double positionAt = measure(10000, [&](int run) {
+        auto position = snapshot.positionAt(offsets[run]);
+        sink += position.line + position.column;
+    });
+    report("offset to line/column", before, positionAt);
+
+    before = measure(200, [&](int run) {
+        int line = lineNumbers[run];
+        qsizetype offset = 0;
+        for (int i = 0; i < line; ++i) {
+            offset = copied.indexOf('\n', offset) + 1;
+        }
+        sink += offset;
+    });
+    after = measure(10000, [&](int run) { sink += snapshot.offsetAt(lineNumbers[run]); });
+    report("line/column to offset", before, after);
+
+    // QTextDocument keeps its own block index, for reference
+    before = measure(10000, [&](int run) {
+        QTextBlock block = plain.findBlock(static_cast<int>(offsets[run]));
+        sink += block.blockNumber() + offsets[run] - block.position();
+    });
+    report("offset to line, findBlock", before, positionAt);
+
+    before = measure(50, [&](int) { sink += plain.toPlainText().count('\n'); });
+    after = measure(50, [&](int) {
+        snapshot.forEachChunk([&](QStringView chunk) {
+            sink += chunk.count('\n');
+            return true;
+        });
+    });
+    report("iterate all the text", before, after);
+
+    out << "(checksum " << sink << ")\n";
+    return 0;
+}
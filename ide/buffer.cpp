@@ -0,0 +1,398 @@
+#include "buffer.h"
+
+#include <QStringEncoder>
+#include <QTextCursor>
+#include <utility>
+
+/* Rope */
+
+// Leaves are merged while they fit in one chunk, and split text is cut into chunks of this size
+#define MAX_CHUNK 2048
+
+struct TextSnapshot::Node {
+    NodePtr left;
+    NodePtr right;
+    QString text; // only leaves hold text
+    qsizetype length;
+    qsizetype newlines;
+    int height; // leaves are at height 0
+};
+
+struct Rope {
+    using Node = TextSnapshot::Node;
+    using NodePtr = TextSnapshot::NodePtr;
+
+    static int height(const NodePtr &n) { return n ? n->height : -1; }
+    static qsizetype length(const NodePtr &n) { return n ? n->length : 0; }
+    static qsizetype newlines(const NodePtr &n) { return n ? n->newlines : 0; }
+
+    static NodePtr leaf(QString text) {
+        if (text.isEmpty()) {
+            return nullptr;
+        }
+        auto length = text.length();
+        auto count = text.count('\n');
+        return std::make_shared<const Node>(nullptr, nullptr, std::move(text), length, count, 0);
+    }
+
+    static NodePtr branch(NodePtr left, NodePtr right) {
+        auto len = length(left) + length(right);
+        auto count = newlines(left) + newlines(right);
+        auto h = qMax(height(left), height(right)) + 1;
+        return std::make_shared<const Node>(std::move(left), std::move(right), QString(), len,
+                                            count, h);
+    }
+
+    /** Make a node of two balanced trees whose heights differ by at most 2 */
+    static NodePtr rebalance(const NodePtr &l, const NodePtr &r) {
+        int hl = height(l), hr = height(r);
+        if (hl > hr + 1) {
+            if (height(l->left) >= height(l->right)) {
+                return branch(l->left, branch(l->right, r));
+            }
+            return branch(branch(l->left, l->right->left), branch(l->right->right, r));
+        }
+        if (hr > hl + 1) {
+            if (height(r->right) >= height(r->left)) {
+                return branch(branch(l, r->left), r->right);
+            }
+            return branch(branch(l, r->left->left), branch(r->left->right, r->right));
+        }
+        return branch(l, r);
+    }
+
+    /** Concatenate two trees, keeping the AVL invariant */
+    static NodePtr join(const NodePtr &l, const NodePtr &r) {
+        if (!l) {
+            return r;
+        }
+        if (!r) {
+            return l;
+        }
+        if (l->height == 0 && r->height == 0 && l->length + r->length <= MAX_CHUNK) {
+            return leaf(l->text + r->text);
+        }
+        int hl = l->height, hr = r->height;
+        if (hl > hr + 1) {
+            return rebalance(l->left, join(l->right, r));
+        }
+        if (hr > hl + 1) {
+            return rebalance(join(l, r->left), r->right);
+        }
+        return branch(l, r);
+    }
+
+    static QPair<NodePtr, NodePtr> split(const NodePtr &n, qsizetype offset) {
+        if (!n) {
+            return {};
+        }
+        if (offset <= 0) {
+            return {nullptr, n};
+        }
+        if (offset >= n->length) {
+            return {n, nullptr};
+        }
+        if (n->height == 0) {
+            return {leaf(n->text.left(offset)), leaf(n->text.mid(offset))};
+        }
+        auto leftLength = n->left->length;
+        if (offset == leftLength) {
+            return {n->left, n->right};
+        }
+        if (offset < leftLength) {
+            auto [a, b] = split(n->left, offset);
+            return {a, join(b, n->right)};
+        }
+        auto [a, b] = split(n->right, offset - leftLength);
+        return {join(n->left, a), b};
+    }
+
+    /** Build a perfectly balanced tree from the given text */
+    static NodePtr build(const QString &text) {
+        QList<NodePtr> leaves;
+        for (qsizetype i = 0; i < text.length();) {
+            qsizetype size = qMin<qsizetype>(MAX_CHUNK, text.length() - i);
+            // never cut a surrogate pair into two chunks
+            if (i + size < text.length() && text.at(i + size - 1).isHighSurrogate()) {
+                size++;
+            }
+            leaves.append(leaf(text.mid(i, size)));
+            i += size;
+        }
+        return build(leaves, 0, leaves.size());
+    }
+
+    static NodePtr build(const QList<NodePtr> &leaves, qsizetype from, qsizetype to) {
+        if (from >= to) {
+            return nullptr;
+        }
+        if (to - from == 1) {
+            return leaves[from];
+        }
+        auto mid = from + (to - from) / 2;
+        return branch(build(leaves, from, mid), build(leaves, mid, to));
+    }
+
+    /** Offset of the first character of the line, which must exist */
+    static qsizetype lineStart(const NodePtr &root, int line) {
+        if (line <= 0) {
+            return 0;
+        }
+        // find the line-th '\n', the line starts right after it
+        qsizetype start = 0;
+        qsizetype remain = line;
+        auto node = root;
+        while (node->height > 0) {
+            if (node->left->newlines >= remain) {
+                node = node->left;
+            } else {
+                remain -= node->left->newlines;
+                start += node->left->length;
+                node = node->right;
+            }
+        }
+        qsizetype index = -1;
+        while (remain-- > 0) {
+            index = node->text.indexOf('\n', index + 1);
+        }
+        return start + index + 1;
+    }
+
+    static bool forEach(const NodePtr &n, qsizetype base, qsizetype from, qsizetype to,
+                        const std::function<bool(QStringView)> &fn) {
+        if (!n || base >= to || base + n->length <= from) {
+            return true;
+        }
+        if (n->height == 0) {
+            auto start = qMax<qsizetype>(from - base, 0);
+            auto end = qMin<qsizetype>(to - base, n->length);
+            return fn(QStringView(n->text).mid(start, end - start));
+        }
+        return forEach(n->left, base, from, to, fn) &&
+               forEach(n->right, base + n->left->length, from, to, fn);
+    }
+};
+
+TextSnapshot::TextSnapshot() = default;
+
+TextSnapshot::TextSnapshot(NodePtr root) : root(std::move(root)) {}
+
+TextSnapshot::TextSnapshot(const QString &text) : root(Rope::build(text)) {}
+
+qsizetype TextSnapshot::length() const { return Rope::length(root); }
+
+bool TextSnapshot::isEmpty() const { return length() == 0; }
+
+bool TextSnapshot::isIdenticalTo(const TextSnapshot &other) const { return root == other.root; }
+
+int TextSnapshot::lineCount() const { return static_cast<int>(Rope::newlines(root)) + 1; }
+
+QChar TextSnapshot::at(qsizetype offset) const {
+    auto chunk = chunkAt(offset);
+    return chunk.isEmpty() ? QChar() : chunk.front();
+}
+
+QString TextSnapshot::text() const { return mid(0, length()); }
+
+QString TextSnapshot::mid(qsizetype offset, qsizetype length) const {
+    QString result;
+    result.reserve(qBound<qsizetype>(0, length, this->length()));
+    forEachChunk(offset, offset + length, [&result](QStringView chunk) {
+        result.append(chunk);
+        return true;
+    });
+    return result;
+}
+
+QString TextSnapshot::lineText(int line) const {
+    if (line < 0 || line >= lineCount()) {
+        return {};
+    }
+    auto start = Rope::lineStart(root, line);
+    auto end = line + 1 < lineCount() ? Rope::lineStart(root, line + 1) - 1 : length();
+    return mid(start, end - start);
+}
+
+QByteArray TextSnapshot::toUtf8() const {
+    QByteArray result;
+    result.reserve(length());
+    // the encoder keeps its state, so surrogate pairs split by an edit are still encoded well
+    QStringEncoder encoder(QStringEncoder::Utf8);
+    forEachChunk([&](QStringView chunk) {
+        result.append(encoder(chunk));
+        return true;
+    });
+    return result;
+}
+
+int TextSnapshot::lineAt(qsizetype offset) const {
+    offset = qBound<qsizetype>(0, offset, length());
+    qsizetype lines = 0;
+    auto node = root;
+    while (node && node->height > 0) {
+        if (offset < node->left->length) {
+            node = node->left;
+        } else {
+            lines += node->left->newlines;
+            offset -= node->left->length;
+            node = node->right;
+        }
+    }
+    if (node) {
+        lines += QStringView(node->text).left(offset).count('\n');
+    }
+    return static_cast<int>(lines);
+}
+
+TextPosition TextSnapshot::positionAt(qsizetype offset) const {
+    offset = qBound<qsizetype>(0, offset, length());
+    int line = lineAt(offset);
+    return {line, static_cast<int>(offset - offsetAt(line))};
+}
+
+qsizetype TextSnapshot::offsetAt(int line, int column) const {
+    line = qBound(0, line, lineCount() - 1);
+    auto start = Rope::lineStart(root, line);
+    auto end = line + 1 < lineCount() ? Rope::lineStart(root, line + 1) - 1 : length();
+    return qMin(start + qMax(column, 0), end);
+}
+
+QStringView TextSnapshot::chunkAt(qsizetype offset) const {
+    if (offset < 0 || offset >= length()) {
+        return {};
+    }
+    auto node = root;
+    while (node->height > 0) {
+        if (offset < node->left->length) {
+            node = node->left;
+        } else {
+            offset -= node->left->length;
+            node = node->right;
+        }
+    }
+    return QStringView(node->text).mid(offset);
+}
+
+void TextSnapshot::forEachChunk(qsizetype from, qsizetype to,
+                                const std::function<bool(QStringView chunk)> &fn) const {
+    Rope::forEach(root, 0, from, to, fn);
+}
+
+void TextSnapshot::forEachChunk(const std::function<bool(QStringView chunk)> &fn) const {
+    forEachChunk(0, length(), fn);
+}
+
+TextSnapshot TextSnapshot::inserted(qsizetype offset, const QString &text) const {
+    if (text.isEmpty()) {
+        return *this;
+    }
+    auto [left, right] = Rope::split(root, offset);
+    return TextSnapshot(Rope::join(Rope::join(left, Rope::build(text)), right));
+}
+
+TextSnapshot TextSnapshot::removed(qsizetype offset, qsizetype length) const {
+    if (length <= 0) {
+        return *this;
+    }
+    auto [left, rest] = Rope::split(root, offset);
+    auto [_, right] = Rope::split(rest, length);
+    return TextSnapshot(Rope::join(left, right));
+}
+
+TextSnapshot TextSnapshot::replaced(qsizetype offset, qsizetype length, const QString &text) const {
+    return removed(offset, length).inserted(offset, text);
+}
+
+/* Text buffer */
+
+// edits within a frame (ms) are dispatched at once
+#define DISPATCH_INTERVAL 16
+
+TextBuffer::TextBuffer(QTextDocument *document) : QObject(document), document(document) {
+    resync();
+    dispatchTimer.setSingleShot(true);
+    dispatchTimer.setInterval(DISPATCH_INTERVAL);
+    connect(&dispatchTimer, &QTimer::timeout, this, &TextBuffer::flush);
+    connect(document, &QTextDocument::contentsChange, this, &TextBuffer::onContentsChange);
+}
+
+TextBuffer *TextBuffer::of(QTextDocument *document) {
+    if (auto *buffer = document->findChild<TextBuffer *>(Qt::FindDirectChildrenOnly)) {
+        return buffer;
+    }
+    return new TextBuffer(document);
+}
+
+TextSnapshot TextBuffer::snapshot() const { return current; }
+
+quint64 TextBuffer::version() const { return currentVersion; }
+
+void TextBuffer::record(int position, int charsRemoved, const QString &added,
+                        const TextSnapshot &before) {
+    if (pending.changes.isEmpty()) {
+        pending.before = before;
+        dispatchTimer.start();
+    }
+    pending.changes.append({position, charsRemoved, added, ++currentVersion});
+    pending.after = current;
+}
+
+void TextBuffer::flush() {
+    dispatchTimer.stop();
+    if (pending.changes.isEmpty()) {
+        return;
+    }
+    // taken first, the listeners may edit again
+    auto changes = std::exchange(pending, TextChanges());
+    emit changed(changes);
+}
+
+QString TextBuffer::readDocument(int position, int length) const {
+    if (length <= 0) {
+        return {};
+    }
+    QTextCursor cursor(document);
+    cursor.setPosition(position);
+    cursor.setPosition(position + length, QTextCursor::KeepAnchor);
+    QString text = cursor.selectedText();
+    // use the same conversions as QTextDocument::toPlainText
+    for (auto &c: text) {
+        if (c == QChar::ParagraphSeparator || c == QChar::LineSeparator) {
+            c = u'\n';
+        } else if (c == QChar::Nbsp) {
+            c = u' ';
+        }
+    }
+    return text;
+}
+
+void TextBuffer::resync() { current = TextSnapshot(document->toPlainText()); }
+
+void TextBuffer::onContentsChange(int position, int charsRemoved, int charsAdded) {
+    // The document counts its last paragraph separator, which is not part of the plain text,
+    // so the reported numbers may run past the end (e.g. on setPlainText). Clamp them here.
+    int docLength = document->characterCount() - 1;
+    auto before = current;
+    int oldLength = static_cast<int>(before.length());
+    if (position < 0 || position > oldLength) {
+        resync();
+        record(0, oldLength, current.text(), before);
+        return;
+    }
+    int removed = qMin(charsRemoved, oldLength - position);
+    int added = qBound(0, charsAdded, docLength - position);
+
+    QString text = readDocument(position, added);
+    if (removed == added && current.mid(position, removed) == text) {
+        // only the format changed (e.g. by the highlighter)
+        return;
+    }
+    current = current.replaced(position, removed, text);
+    if (current.length() != docLength) {
+        qWarning() << "TextBuffer: out of sync with the document, rebuilding";
+        resync();
+        record(0, oldLength, current.text(), before);
+        return;
+    }
+    record(position, removed, text, before);
+}
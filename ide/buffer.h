@@ -0,0 +1,124 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include <QObject>
+#include <QString>
+#include <QTextDocument>
+#include <QTimer>
+#include <functional>
+#include <memory>
+
+struct TextPosition {
+    int line;
+    int column;
+};
+
+/**
+ * An immutable view of the text, stored as a persistent balanced rope.
+ * Copying a snapshot only copies a pointer, and edits share the untouched
+ * nodes with the original, so snapshots can be handed to other threads freely.
+ */
+class TextSnapshot {
+    friend struct Rope;
+
+    struct Node;
+    using NodePtr = std::shared_ptr<const Node>;
+
+    NodePtr root;
+
+    explicit TextSnapshot(NodePtr root);
+
+public:
+    TextSnapshot();
+    explicit TextSnapshot(const QString &text);
+
+    qsizetype length() const;
+    bool isEmpty() const;
+    /** True when both come from the same edit, without comparing the content */
+    bool isIdenticalTo(const TextSnapshot &other) const;
+    /** Number of lines, which is always one more than the count of '\n' */
+    int lineCount() const;
+
+    QChar at(qsizetype offset) const;
+    QString text() const;
+    QString mid(qsizetype offset, qsizetype length) const;
+    QString lineText(int line) const;
+    QByteArray toUtf8() const;
+
+    /** O(log n) conversions between offsets and line/column positions */
+    int lineAt(qsizetype offset) const;
+    TextPosition positionAt(qsizetype offset) const;
+    qsizetype offsetAt(int line, int column = 0) const;
+
+    /** The contiguous piece of text from offset to the end of its chunk */
+    QStringView chunkAt(qsizetype offset) const;
+    /** Visit the chunks covering [from, to) in order, stop when fn returns false */
+    void forEachChunk(qsizetype from, qsizetype to,
+                      const std::function<bool(QStringView chunk)> &fn) const;
+    void forEachChunk(const std::function<bool(QStringView chunk)> &fn) const;
+
+    TextSnapshot inserted(qsizetype offset, const QString &text) const;
+    TextSnapshot removed(qsizetype offset, qsizetype length) const;
+    TextSnapshot replaced(qsizetype offset, qsizetype length, const QString &text) const;
+};
+
+/** A real edit of the text, version is the one of the buffer right after it */
+struct TextChange {
+    int position;
+    int charsRemoved;
+    QString added;
+    quint64 version;
+};
+
+/** Edits dispatched together, each one applies to the text left by the previous one */
+struct TextChanges {
+    TextSnapshot before;
+    TextSnapshot after;
+    QList<TextChange> changes;
+};
+
+/**
+ * A rope kept in sync with a QTextDocument.
+ * Readers take snapshots instead of calling toPlainText() on the document.
+ * It is also the change bus of the document: the edits made within a frame (a paste, a replace
+ * or an insertion made of many steps) are sent to the listeners as a single batch.
+ */
+class TextBuffer : public QObject {
+    Q_OBJECT
+
+    QTextDocument *document;
+    TextSnapshot current;
+    quint64 currentVersion = 0;
+    /** Edits not dispatched yet */
+    TextChanges pending;
+    QTimer dispatchTimer;
+
+    explicit TextBuffer(QTextDocument *document);
+    /** Read [position, position + length) from the document as plain text */
+    QString readDocument(int position, int length) const;
+    /** Rebuild the rope from the document, used when the change reported is not consistent */
+    void resync();
+    void record(int position, int charsRemoved, const QString &added, const TextSnapshot &before);
+
+private slots:
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+
+signals:
+    /** Real edits have been applied, formatting-only changes are filtered out */
+    void changed(const TextChanges &changes);
+
+public:
+    /** Get the buffer attached to the document, creating it when absent */
+    static TextBuffer *of(QTextDocument *document);
+    /** The latest text, which may include edits not dispatched yet */
+    TextSnapshot snapshot() const;
+    /** Count of the edits so far */
+    quint64 version() const;
+    /**
+     * Dispatch the pending edits now.
+     * Call it before taking a snapshot that is matched against the changes received later.
+     */
+    void flush();
+};
+
+#endif // BUFFER_H
@@ -0,0 +1,207 @@
+#include "diff.h"
+
+#include <QHash>
+#include <optional>
+#include <vector>
+
+// stop looking for the shortest script after this many differences in a range,
+// the range is replaced as a whole then, which is still correct
+#define MAX_EDIT_COST 2048
+
+struct Lines {
+    /** Every distinct line gets an id, so lines are compared as integers */
+    std::vector<int> ids;
+    /** Offset of every line, and the length of the text at the end */
+    std::vector<qsizetype> starts;
+};
+
+/** Replace the lines [oldFrom, oldTo) by [newFrom, newTo) of the new text */
+struct LineHunk {
+    int oldFrom;
+    int oldTo;
+    int newFrom;
+    int newTo;
+};
+
+static Lines splitLines(const QString &text, QHash<QStringView, int> &ids) {
+    Lines lines;
+    qsizetype start = 0;
+    while (start < text.size()) {
+        qsizetype end = text.indexOf(u'\n', start);
+        end = end == -1 ? text.size() : end + 1;
+        auto line = QStringView(text).sliced(start, end - start);
+        auto it = ids.constFind(line);
+        if (it == ids.cend()) {
+            it = ids.insert(line, static_cast<int>(ids.size()));
+        }
+        lines.ids.push_back(*it);
+        lines.starts.push_back(start);
+        start = end;
+    }
+    lines.starts.push_back(text.size());
+    return lines;
+}
+
+/** The bisection of Myers' paper, the forward and backward searches meet in the middle */
+class MyersDiff {
+    const std::vector<int> &a;
+    const std::vector<int> &b;
+    std::vector<int> forward;
+    std::vector<int> backward;
+
+    /** The point to split the ranges at, nothing if it costs too much to find */
+    std::optional<std::pair<int, int>> bisect(int aLo, int aHi, int bLo, int bHi);
+    void addHunk(int aLo, int aHi, int bLo, int bHi);
+
+public:
+    QList<LineHunk> hunks;
+
+    MyersDiff(const std::vector<int> &a, const std::vector<int> &b);
+    void diff(int aLo, int aHi, int bLo, int bHi);
+};
+
+MyersDiff::MyersDiff(const std::vector<int> &a, const std::vector<int> &b) : a(a), b(b) {
+    int maxD = std::min(static_cast<int>(a.size() + b.size() + 1) / 2, MAX_EDIT_COST);
+    forward.resize(2 * maxD + 2);
+    backward.resize(2 * maxD + 2);
+}
+
+void MyersDiff::addHunk(int aLo, int aHi, int bLo, int bHi) {
+    // the ranges are found in order, so only the last hunk may touch this one
+    if (!hunks.isEmpty() && hunks.last().oldTo == aLo && hunks.last().newTo == bLo) {
+        hunks.last().oldTo = aHi;
+        hunks.last().newTo = bHi;
+        return;
+    }
+    hunks.append({aLo, aHi, bLo, bHi});
+}
+
+void MyersDiff::diff(int aLo, int aHi, int bLo, int bHi) {
+    while (aLo < aHi && bLo < bHi && a[aLo] == b[bLo]) {
+        ++aLo;
+        ++bLo;
+    }
+    while (aLo < aHi && bLo < bHi && a[aHi - 1] == b[bHi - 1]) {
+        --aHi;
+        --bHi;
+    }
+    if (aLo == aHi && bLo == bHi) {
+        return;
+    }
+    if (aLo == aHi || bLo == bHi) {
+        addHunk(aLo, aHi, bLo, bHi); // only insertions or deletions
+        return;
+    }
+    auto split = bisect(aLo, aHi, bLo, bHi);
+    if (!split) {
+        addHunk(aLo, aHi, bLo, bHi);
+        return;
+    }
+    auto [x, y] = *split;
+    diff(aLo, aLo + x, bLo, bLo + y);
+    diff(aLo + x, aHi, bLo + y, bHi);
+}
+
+std::optional<std::pair<int, int>> MyersDiff::bisect(int aLo, int aHi, int bLo, int bHi) {
+    int n = aHi - aLo;
+    int m = bHi - bLo;
+    int maxD = std::min((n + m + 1) / 2, MAX_EDIT_COST);
+    int offset = maxD;
+    int length = 2 * maxD + 2;
+    std::fill_n(forward.begin(), length, -1);
+    std::fill_n(backward.begin(), length, -1);
+    forward[offset + 1] = 0;
+    backward[offset + 1] = 0;
+
+    int delta = n - m;
+    // with an odd delta, the forward search is the one to meet the backward one
+    bool front = delta % 2 != 0;
+    // diagonals running off the ranges are not searched anymore
+    int k1Start = 0, k1End = 0, k2Start = 0, k2End = 0;
+    for (int d = 0; d < maxD; ++d) {
+        for (int k1 = -d + k1Start; k1 <= d - k1End; k1 += 2) {
+            int k1Offset = offset + k1;
+            int x1 = k1 == -d || (k1 != d && forward[k1Offset - 1] < forward[k1Offset + 1])
+                             ? forward[k1Offset + 1]
+                             : forward[k1Offset - 1] + 1;
+            int y1 = x1 - k1;
+            while (x1 < n && y1 < m && a[aLo + x1] == b[bLo + y1]) {
+                ++x1;
+                ++y1;
+            }
+            forward[k1Offset] = x1;
+            if (x1 > n) {
+                k1End += 2;
+            } else if (y1 > m) {
+                k1Start += 2;
+            } else if (front) {
+                int k2Offset = offset + delta - k1;
+                if (k2Offset >= 0 && k2Offset < length && backward[k2Offset] != -1 &&
+                    x1 >= n - backward[k2Offset]) {
+                    return std::pair{x1, y1};
+                }
+            }
+        }
+        for (int k2 = -d + k2Start; k2 <= d - k2End; k2 += 2) {
+            int k2Offset = offset + k2;
+            int x2 = k2 == -d || (k2 != d && backward[k2Offset - 1] < backward[k2Offset + 1])
+                             ? backward[k2Offset + 1]
+                             : backward[k2Offset - 1] + 1;
+            int y2 = x2 - k2;
+            while (x2 < n && y2 < m && a[aHi - 1 - x2] == b[bHi - 1 - y2]) {
+                ++x2;
+                ++y2;
+            }
+            backward[k2Offset] = x2;
+            if (x2 > n) {
+                k2End += 2;
+            } else if (y2 > m) {
+                k2Start += 2;
+            } else if (!front) {
+                int k1Offset = offset + delta - k2;
+                if (k1Offset >= 0 && k1Offset < length && forward[k1Offset] != -1) {
+                    int x1 = forward[k1Offset];
+                    int y1 = offset + x1 - k1Offset;
+                    if (x1 >= n - x2) {
+                        return std::pair{x1, y1};
+                    }
+                }
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+QList<DiffHunk> TextDiff::compute(const QString &oldText, const QString &newText) {
+    QHash<QStringView, int> ids;
+    auto oldLines = splitLines(oldText, ids);
+    auto newLines = splitLines(newText, ids);
+    MyersDiff differ(oldLines.ids, newLines.ids);
+    differ.diff(0, static_cast<int>(oldLines.ids.size()), 0, static_cast<int>(newLines.ids.size()));
+
+    QList<DiffHunk> result;
+    for (const auto &[oldFrom, oldTo, newFrom, newTo]: differ.hunks) {
+        qsizetype from = oldLines.starts[oldFrom], to = oldLines.starts[oldTo];
+        qsizetype addFrom = newLines.starts[newFrom], addTo = newLines.starts[newTo];
+        // narrow down to the characters that differ, such as a word changed in a line
+        while (from < to && addFrom < addTo && oldText[from] == newText[addFrom]) {
+            ++from;
+            ++addFrom;
+        }
+        while (from < to && addFrom < addTo && oldText[to - 1] == newText[addTo - 1]) {
+            --to;
+            --addTo;
+        }
+        // never split a surrogate pair
+        if (from > 0 && oldText[from - 1].isHighSurrogate()) {
+            --from;
+            --addFrom;
+        }
+        if (to < oldText.size() && oldText[to].isLowSurrogate()) {
+            ++to;
+            ++addTo;
+        }
+        result.append({from, to - from, newText.sliced(addFrom, addTo - addFrom)});
+    }
+    return result;
+}
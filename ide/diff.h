@@ -0,0 +1,25 @@
+#ifndef DIFF_H
+#define DIFF_H
+
+#include <QList>
+#include <QString>
+
+/** Replace [position, position + charsRemoved) of the old text by added */
+struct DiffHunk {
+    qsizetype position;
+    qsizetype charsRemoved;
+    QString added;
+};
+
+/**
+ * Line based Myers diff in linear space.
+ * Applying the hunks from the last one to the first turns the old text into the new one,
+ * so an editor only touches the lines that really differ.
+ */
+class TextDiff {
+public:
+    /** Hunks in the order of the old text, each one narrowed down to the characters that differ */
+    static QList<DiffHunk> compute(const QString &oldText, const QString &newText);
+};
+
+#endif // DIFF_H
@@ -1,21 +1,37 @@
 #include "highlighter.h"
+#include <QElapsedTimer>
 #include <QJsonArray>
 #include <QLibrary>
 #include <qcorotimer.h>
+#include <optional>
 #include <utility>
 
 #include "../util/file.h"
+#include "../util/latency.h"
+#include "../util/metrics.h"
+#include "../util/trace.h"
+#include "../util/watchdog.h"
+
+#if TREE_SITTER_LANGUAGE_VERSION >= 15
+#define TS_INPUT_ENCODING_UTF16 TSInputEncodingUTF16LE
+#else
+#define TS_INPUT_ENCODING_UTF16 TSInputEncodingUTF16
+#endif
 
 // TODO: optimize the rule memory use
 Highlighter::Highlighter(const TSLanguage *language, QString langName, QTextDocument *parent) :
-    QSyntaxHighlighter(parent), language(language), langName(std::move(langName)), parsing(false) {
-    parser = ts_parser_new();
-    ts_parser_set_language(parser, language);
+    QSyntaxHighlighter(parent), language(language), langName(std::move(langName)),
+    buffer(TextBuffer::of(parent)), parsing(false) {
+    parser = std::shared_ptr<TSParser>(ts_parser_new(), ts_parser_delete);
+    ts_parser_set_language(parser.get(), language);
     queries.clear();
     Configs::bindHotUpdateOn(this, "highlightRules", &Highlighter::readRules);
     Configs::instance().manuallyUpdate("highlightRules");
     setupBracketQuery();
-    connect(document(), &QTextDocument::contentsChange, this, &Highlighter::onContentsChanged);
+    // start from a text the later changes apply to
+    buffer->flush();
+    source = buffer->snapshot();
+    connect(buffer, &TextBuffer::changed, this, &Highlighter::onTextChanged);
 }
 
 QPair<TSLanguage *, QString> Highlighter::toTSLanguage(Language language) {
@@ -49,8 +65,23 @@ QPair<TSLanguage *, QString> Highlighter::toTSLanguage(Language language) {
     return {languageFn(), name};
 }
 
+static Histogram &parseTime() {
+    static auto &histogram = Metrics::instance().histogram(
+            "neverjudge_highlighter_parse_ms", "Time of a tree-sitter parse in ms.",
+            {1, 2, 5, 10, 20, 50, 100, 200, 500, 1000});
+    return histogram;
+}
+
+static Gauge &spanBytes() {
+    static auto &gauge = Metrics::instance().gauge("neverjudge_highlight_span_bytes",
+                                                   "Bytes held by the highlight ranges.");
+    return gauge;
+}
+
 Highlighter::~Highlighter() {
-    disconnect(document(), &QTextDocument::contentsChange, this, &Highlighter::onContentsChanged);
+    alive.cancel();
+    spanBytes().add(-heldBytes);
+    disconnect(buffer, &TextBuffer::changed, this, &Highlighter::onTextChanged);
     if (tree) {
         ts_tree_delete(tree);
     }
@@ -60,8 +91,6 @@ Highlighter::~Highlighter() {
         if (query)
             ts_query_delete(query);
     }
-    if (parser)
-        ts_parser_delete(parser);
     if (bracketCursor)
         ts_query_cursor_delete(bracketCursor);
     if (bracketQuery)
@@ -98,6 +127,8 @@ void Highlighter::setCursorPosition(int pos, const QTextBlock &block) {
 }
 
 void Highlighter::highlightBlock(const QString &text) {
+    // the blocks of an edit and of the bracket under the cursor, in the keystroke measured
+    LatencyScope scope(LatencyPhase::Highlight);
     setFormat(0, text.length(), QTextCharFormat()); // reset format
 
     for (auto &result: results) {
@@ -118,7 +149,6 @@ void Highlighter::highlightBlock(const QString &text) {
         }
     }
     highlightBracketPairs(text);
-    textNotChanged = true;
 }
 
 QTextCharFormat Highlighter::matchFormat(QTextCharFormat format) {
@@ -142,8 +172,9 @@ void Highlighter::highlightBracketPairs(const QString &text) {
         return;
     }
 
-    auto utf8Content = document()->toPlainText().toUtf8();
-
+    if (!tree) {
+        return;
+    }
     TSNode root = ts_tree_root_node(tree);
     ts_query_cursor_exec(bracketCursor, bracketQuery, root);
 
@@ -171,8 +202,8 @@ void Highlighter::highlightBracketPairs(const QString &text) {
         }
 
         if (hasLeft && hasRight) {
-            int leftCharPos = byteToCharPosition(leftPos, utf8Content);
-            int rightCharPos = byteToCharPosition(rightPos, utf8Content);
+            int leftCharPos = toCharPosition(leftPos);
+            int rightCharPos = toCharPosition(rightPos);
 
             int left = leftCharPos - blockPos;
             int right = rightCharPos - blockPos;
@@ -201,7 +232,31 @@ void Highlighter::highlightBracketPairs(const QString &text) {
 }
 
 
-void Highlighter::onContentsChanged(int, int, int) { parseDocument(); }
+static TSPoint pointAt(const TextSnapshot &snapshot, qsizetype offset) {
+    auto [line, column] = snapshot.positionAt(offset);
+    return {static_cast<uint32_t>(line), static_cast<uint32_t>(column * sizeof(char16_t))};
+}
+
+void Highlighter::onTextChanged(const TextChanges &changes) {
+    // replay the changes to get the positions of each edit in the text it was made on
+    auto current = changes.before;
+    for (const auto &change: changes.changes) {
+        qsizetype start = change.position;
+        qsizetype oldEnd = start + change.charsRemoved;
+        qsizetype newEnd = start + change.added.length();
+        TSInputEdit edit{};
+        edit.start_byte = static_cast<uint32_t>(start * sizeof(char16_t));
+        edit.old_end_byte = static_cast<uint32_t>(oldEnd * sizeof(char16_t));
+        edit.new_end_byte = static_cast<uint32_t>(newEnd * sizeof(char16_t));
+        edit.start_point = pointAt(current, start);
+        edit.old_end_point = pointAt(current, oldEnd);
+        current = current.replaced(start, change.charsRemoved, change.added);
+        edit.new_end_point = pointAt(current, newEnd);
+        edits.append(edit);
+    }
+    source = changes.after;
+    parseDocument();
+}
 
 void Highlighter::readRules(const QJsonValue &jsonRules) {
     if (!jsonRules.isArray()) {
@@ -285,77 +340,119 @@ void Highlighter::readRules(const QJsonValue &jsonRules) {
 
 QCoro::Task<> Highlighter::parseDocument() {
     if (parsing) {
+        stale = true;
         co_return;
     }
-
-    auto utf8Content = document()->toPlainText().toUtf8();
-    // TODO: use old tree here for better performance
     parsing = true;
-    if (tree) {
-        ts_tree_delete(tree);
-    }
-    tree = ts_parser_parse_string(parser, nullptr, utf8Content.constData(), utf8Content.size());
-
-    TSNode root = ts_tree_root_node(tree);
-    results.clear();
-
-    int batchSize = 10000;
-    int cnt = 0;
-
-    for (auto &[query, cursor, format]: queries) {
-        ts_query_cursor_exec(cursor, query, root);
-
-        TSQueryMatch match;
-        QList<QPair<int, int>> strRanges;
-        while (ts_query_cursor_next_match(cursor, &match)) {
-            for (uint32_t i = 0; i < match.capture_count; ++i) {
-                TSNode node = match.captures[i].node;
-                uint32_t startByte = ts_node_start_byte(node);
-                uint32_t endByte = ts_node_end_byte(node);
-
-                // Convert byte offsets to character positions
-                int startPos = byteToCharPosition(startByte, utf8Content);
-                int endPos = byteToCharPosition(endByte, utf8Content);
-                strRanges.emplace_back(startPos, endPos);
+    TraceSpan span("highlighter", "Highlighter::parseDocument");
+    do {
+        stale = false;
+        // the snapshot must outlive the tree-sitter reads
+        auto snapshot = source;
+        // the edited old tree lets tree-sitter reuse the subtrees the edits did not touch
+        if (tree) {
+            for (const auto &edit: edits) {
+                ts_tree_edit(tree, &edit);
             }
-            if (++cnt % batchSize == 0) {
-                co_await QCoro::sleepFor(std::chrono::milliseconds(100));
+        }
+        edits.clear();
+        // a copy of the tree is needed to read it on another thread, the brackets read this one
+        TSTree *oldTree = tree ? ts_tree_copy(tree) : nullptr;
+        auto sharedParser = parser;
+        auto token = alive;
+
+        co_await resumeOnWorker();
+        TSTree *newTree;
+        {
+            TraceSpan parseSpan("highlighter", "Highlighter::parse");
+            QElapsedTimer timer;
+            timer.start();
+            newTree = parseSnapshot(sharedParser.get(), snapshot, oldTree);
+            if (oldTree) {
+                ts_tree_delete(oldTree);
             }
+            parseTime().observe(static_cast<double>(timer.nsecsElapsed()) / 1e6);
+        }
+        if (!co_await resumeOnMain(token)) {
+            ts_tree_delete(newTree);
+            co_return;
         }
+        if (tree) {
+            ts_tree_delete(tree);
+        }
+        tree = newTree;
+
+        TSNode root = ts_tree_root_node(tree);
+        results.clear();
+
+        int batchSize = 10000;
+        int cnt = 0;
+        // left while sleeping between the batches
+        std::optional<WatchdogScope> scope(std::in_place, "Highlighter::query");
+
+        for (auto &[query, cursor, format]: queries) {
+            ts_query_cursor_exec(cursor, query, root);
+
+            TSQueryMatch match;
+            QList<QPair<int, int>> strRanges;
+            while (ts_query_cursor_next_match(cursor, &match)) {
+                for (uint32_t i = 0; i < match.capture_count; ++i) {
+                    TSNode node = match.captures[i].node;
+                    uint32_t startByte = ts_node_start_byte(node);
+                    uint32_t endByte = ts_node_end_byte(node);
+
+                    // Convert byte offsets to character positions
+                    int startPos = toCharPosition(startByte);
+                    int endPos = toCharPosition(endByte);
+                    strRanges.emplace_back(startPos, endPos);
+                }
+                if (++cnt % batchSize == 0) {
+                    scope.reset();
+                    co_await QCoro::sleepFor(std::chrono::milliseconds(100));
+                    if (token.isCanceled()) {
+                        co_return;
+                    }
+                    scope.emplace("Highlighter::query");
+                }
+            }
 
-        results.emplace_back(strRanges, format);
-    }
-    rehighlight();
+            results.emplace_back(strRanges, format);
+        }
+        qint64 bytes = 0;
+        for (const auto &result: results) {
+            bytes += result.strRanges.capacity() * static_cast<qint64>(sizeof(QPair<int, int>));
+        }
+        spanBytes().add(bytes - heldBytes);
+        heldBytes = bytes;
+        scope.emplace("Highlighter::rehighlight");
+        rehighlight();
+    } while (stale);
     parsing = false;
     co_return;
 }
 
-int Highlighter::byteToCharPosition(uint32_t bytePos, const QByteArray &utf8) {
-    static const QByteArray *utf8Ptr = nullptr;
-    static QList<int> byteOffsets = {}; // charPos -> bytePos
-
-    if (utf8Ptr != &utf8) {
-        // build cache
-        byteOffsets.clear();
-        for (int byteOffset = 0; byteOffset < utf8.size();) {
-            byteOffsets.append(byteOffset);
-            uchar ch = utf8[byteOffset];
-
-            if (ch < 0x80)
-                byteOffset += 1;
-            else if ((ch & 0xE0) == 0xC0)
-                byteOffset += 2;
-            else if ((ch & 0xF0) == 0xE0)
-                byteOffset += 3;
-            else if ((ch & 0xF8) == 0xF0)
-                byteOffset += 4;
-        }
-        utf8Ptr = &utf8;
+int Highlighter::toCharPosition(uint32_t bytePos) {
+    return static_cast<int>(bytePos / sizeof(char16_t));
+}
+
+static const char *readSnapshot(void *payload, uint32_t byteIndex, TSPoint, uint32_t *bytesRead) {
+    const auto *snapshot = static_cast<const TextSnapshot *>(payload);
+    auto chunk = snapshot->chunkAt(byteIndex / sizeof(char16_t));
+    if (chunk.isEmpty()) {
+        *bytesRead = 0;
+        return "";
     }
+    *bytesRead = static_cast<uint32_t>(chunk.size() * sizeof(char16_t));
+    return reinterpret_cast<const char *>(chunk.utf16());
+}
 
-    // use binary search with complexity O(log n)
-    auto it = std::ranges::upper_bound(byteOffsets, bytePos);
-    return static_cast<int>(it - byteOffsets.begin() - 1);
+TSTree *Highlighter::parseSnapshot(TSParser *parser, const TextSnapshot &snapshot,
+                                   const TSTree *oldTree) {
+    TSInput input{};
+    input.payload = const_cast<TextSnapshot *>(&snapshot);
+    input.read = readSnapshot;
+    input.encoding = TS_INPUT_ENCODING_UTF16;
+    return ts_parser_parse(parser, oldTree, input);
 }
 
 Highlighter *HighlighterFactory::getHighlighter(Language language, QTextDocument *parent) {
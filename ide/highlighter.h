@@ -4,9 +4,12 @@
 #include <QJsonObject>
 #include <QSyntaxHighlighter>
 #include <QTextCharFormat>
+#include <memory>
 #include <qcorotask.h>
 #include <tree_sitter/api.h>
 
+#include "../util/worker.h"
+#include "buffer.h"
 #include "language.h"
 
 struct HighlightRule {
@@ -32,30 +35,45 @@ class Highlighter : public QSyntaxHighlighter {
     const TSLanguage *language;
     QString langName;
     TSTree *tree = nullptr;
-    TSParser *parser = nullptr;
+    /** Shared with the parse running on a worker, which may outlive the highlighter */
+    std::shared_ptr<TSParser> parser;
+    /** Canceled when destroyed, so the parse coming back from a worker stops */
+    CancelToken alive;
+    TextBuffer *buffer;
+    /** The text to parse, it only moves forward with the changes received */
+    TextSnapshot source;
+    /** Edits since the last parse, applied to the old tree so that it can be reused */
+    QList<TSInputEdit> edits;
 
     QList<Query> queries;
     QList<QueryResult> results;
+    /** The memory of the ranges in the results, for the metrics */
+    qint64 heldBytes = 0;
 
     bool parsing;
+    /** Changed while parsing, so parse again when done */
+    bool stale = false;
 
     int currentCursorPos = -1;
     QTextBlock lastBlock;
     TSQuery *bracketQuery = nullptr;
     TSQueryCursor *bracketCursor = nullptr;
 
-    static int byteToCharPosition(uint32_t bytePos, const QByteArray &utf8);
+    /** The tree is parsed from UTF-16 text, so a character is always two bytes */
+    static int toCharPosition(uint32_t bytePos);
+    /** Parse the snapshot with tree-sitter without copying it into a contiguous string */
+    static TSTree *parseSnapshot(TSParser *parser, const TextSnapshot &snapshot,
+                                 const TSTree *oldTree);
     void highlightBlock(const QString &text) override;
     void setupBracketQuery();
     void highlightBracketPairs(const QString &text);
     static QTextCharFormat matchFormat(QTextCharFormat format);
 
 private slots:
-    void onContentsChanged(int, int, int);
+    void onTextChanged(const TextChanges &changes);
     void readRules(const QJsonValue &jsonRules);
 
 public:
-    mutable bool textNotChanged = true;
     Highlighter(const TSLanguage *language, QString langName, QTextDocument *parent);
     ~Highlighter() override;
     static QPair<TSLanguage *, QString> toTSLanguage(Language language);
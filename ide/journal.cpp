@@ -0,0 +1,262 @@
+#include "journal.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QSaveFile>
+#include <QStringEncoder>
+
+#include "../util/file.h"
+#include "../util/worker.h"
+
+#define JOURNAL_MAGIC 0x4e4a4a4c // "NJJL"
+#define JOURNAL_VERSION 1
+// keystrokes typed within this period (ms) are written at once
+#define FLUSH_INTERVAL 500
+// the journal is compacted when it grows over this size and twice the text
+#define COMPACT_THRESHOLD (1 << 20)
+
+enum RecordType : quint8 {
+    CHANGE = 1, // position, chars removed, text added
+    SNAPSHOT = 2, // the whole text
+};
+
+static SerialQueue &journalQueue() {
+    // one queue keeps the writes of a journal in order
+    static SerialQueue queue;
+    return queue;
+}
+
+static QByteArray hashOf(const TextSnapshot &snapshot) {
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    QStringEncoder encoder(QStringEncoder::Utf8);
+    snapshot.forEachChunk([&](QStringView chunk) {
+        hash.addData(encoder(chunk));
+        return true;
+    });
+    return hash.result();
+}
+
+static QByteArray encodeHeader(const QString &filePath, const TextSnapshot &base) {
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << quint32(JOURNAL_MAGIC) << quint32(JOURNAL_VERSION) << filePath << hashOf(base);
+    return data;
+}
+
+static bool decodeHeader(QDataStream &in, QString &filePath, QByteArray &baseHash) {
+    quint32 magic, version;
+    in >> magic >> version;
+    if (in.status() != QDataStream::Ok || magic != JOURNAL_MAGIC || version != JOURNAL_VERSION) {
+        return false;
+    }
+    in >> filePath >> baseHash;
+    return in.status() == QDataStream::Ok;
+}
+
+static void appendJournal(const QString &journalPath, const QByteArray &header,
+                          const QByteArray &records) {
+    QDir().mkpath(QFileInfo(journalPath).absolutePath());
+    QFile file(journalPath);
+    // a header means the journal starts over
+    QIODevice::OpenMode mode = QIODevice::WriteOnly;
+    mode |= header.isEmpty() ? QIODevice::Append : QIODevice::Truncate;
+    if (!file.open(mode)) {
+        qWarning() << "EditJournal: cannot open" << journalPath << file.errorString();
+        return;
+    }
+    file.write(header);
+    file.write(records);
+}
+
+static void writeCompacted(const QString &journalPath, const QByteArray &header,
+                           const TextSnapshot &snapshot) {
+    QDir().mkpath(QFileInfo(journalPath).absolutePath());
+    // replace the journal atomically, a crash here must not lose the old one
+    QSaveFile file(journalPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "EditJournal: cannot compact" << journalPath << file.errorString();
+        return;
+    }
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out.writeRawData(header.constData(), static_cast<int>(header.size()));
+    out << quint8(SNAPSHOT) << snapshot.text();
+    file.commit();
+}
+
+EditJournal::EditJournal(const QString &filePath, TextBuffer *buffer, QObject *parent) :
+    QObject(parent), filePath(QFileInfo(filePath).absoluteFilePath()),
+    journalPath(pathFor(filePath)), base(buffer->snapshot()), buffer(buffer), journalSize(0),
+    created(false) {
+    flushTimer.setSingleShot(true);
+    flushTimer.setInterval(FLUSH_INTERVAL);
+    connect(&flushTimer, &QTimer::timeout, this, &EditJournal::flush);
+    connect(buffer, &TextBuffer::changed, this, &EditJournal::onChanged);
+}
+
+EditJournal::~EditJournal() {
+    // the buffer may be gone already, so only write what is pending
+    writePending();
+}
+
+QString EditJournal::pathFor(const QString &filePath) {
+    auto key = QFileInfo(filePath).absoluteFilePath().toUtf8();
+    auto name = QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex();
+    return TempFiles::JOURNAL_PATH + "/" + name + ".journal";
+}
+
+void EditJournal::onChanged(const TextChanges &changes) {
+    QDataStream out(&records, QIODevice::WriteOnly | QIODevice::Append);
+    out.setVersion(QDataStream::Qt_6_0);
+    for (const auto &[position, charsRemoved, added, _]: changes.changes) {
+        out << quint8(CHANGE) << quint32(position) << quint32(charsRemoved) << added;
+    }
+    if (!flushTimer.isActive()) {
+        flushTimer.start();
+    }
+}
+
+void EditJournal::flush() {
+    if (records.isEmpty()) {
+        return;
+    }
+    // a long session of edits is cheaper to replay as a snapshot
+    qint64 textSize = buffer->snapshot().length() * 2;
+    if (journalSize + records.size() > qMax<qint64>(COMPACT_THRESHOLD, textSize * 2)) {
+        compact();
+    } else {
+        writePending();
+    }
+}
+
+void EditJournal::writePending() {
+    flushTimer.stop();
+    if (records.isEmpty()) {
+        return;
+    }
+    journalSize += records.size();
+    journalQueue().post([journalPath = journalPath, filePath = filePath,
+                         base = created ? TextSnapshot() : base, fresh = !created,
+                         batch = std::move(records)] {
+        // the hash of the base is computed here, it is not free on large files
+        appendJournal(journalPath, fresh ? encodeHeader(filePath, base) : QByteArray(), batch);
+    });
+    records = QByteArray();
+    created = true;
+}
+
+void EditJournal::compact() {
+    // the snapshot covers the pending changes, they must not be recorded after it
+    buffer->flush();
+    flushTimer.stop();
+    records.clear();
+    auto snapshot = buffer->snapshot();
+    journalQueue().post([journalPath = journalPath, filePath = filePath, base = base, snapshot] {
+        writeCompacted(journalPath, encodeHeader(filePath, base), snapshot);
+    });
+    journalSize = snapshot.length() * 2;
+    created = true;
+}
+
+void EditJournal::rebase(const TextSnapshot &saved) {
+    buffer->flush();
+    base = saved;
+    if (buffer->snapshot().isIdenticalTo(saved)) {
+        discard();
+    } else {
+        // edited during the save, keep what is newer than the disk
+        compact();
+    }
+}
+
+void EditJournal::discard() {
+    buffer->flush();
+    flushTimer.stop();
+    records.clear();
+    journalSize = 0;
+    created = false;
+    journalQueue().post([journalPath = journalPath] { QFile::remove(journalPath); });
+}
+
+std::optional<QString> EditJournal::recover(const QString &filePath,
+                                            const QString &diskContent) {
+    QFile file(pathFor(filePath));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return std::nullopt;
+    }
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    QString path;
+    QByteArray baseHash;
+    if (!decodeHeader(in, path, baseHash) || path != QFileInfo(filePath).absoluteFilePath()) {
+        return std::nullopt;
+    }
+
+    TextSnapshot disk(diskContent);
+    // changes only apply to the content they were recorded on
+    std::optional<TextSnapshot> text;
+    if (hashOf(disk) == baseHash) {
+        text = disk;
+    }
+    while (!in.atEnd()) {
+        quint8 type;
+        in >> type;
+        if (type == CHANGE) {
+            quint32 position, removed;
+            QString added;
+            in >> position >> removed >> added;
+            // the last record may be cut by the crash
+            if (in.status() != QDataStream::Ok) {
+                break;
+            }
+            if (!text) {
+                continue; // the file was changed outside, wait for a snapshot
+            }
+            if (quint64(position) + removed > quint64(text->length())) {
+                qWarning() << "EditJournal: broken record in" << file.fileName();
+                break;
+            }
+            text = text->replaced(position, removed, added);
+        } else if (type == SNAPSHOT) {
+            QString content;
+            in >> content;
+            if (in.status() != QDataStream::Ok) {
+                break;
+            }
+            text = TextSnapshot(content);
+        } else {
+            qWarning() << "EditJournal: unknown record in" << file.fileName();
+            break;
+        }
+    }
+
+    if (!text) {
+        return std::nullopt;
+    }
+    QString result = text->text();
+    if (result == diskContent) {
+        return std::nullopt;
+    }
+    return result;
+}
+
+QStringList EditJournal::pending() {
+    QStringList files;
+    QDir dir(TempFiles::JOURNAL_PATH);
+    for (const auto &info: dir.entryInfoList({"*.journal"}, QDir::Files)) {
+        QFile file(info.filePath());
+        if (!file.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        QDataStream in(&file);
+        in.setVersion(QDataStream::Qt_6_0);
+        QString path;
+        QByteArray baseHash;
+        if (decodeHeader(in, path, baseHash) && QFileInfo::exists(path)) {
+            files.append(path);
+        }
+    }
+    return files;
+}
@@ -0,0 +1,56 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <QObject>
+#include <QTimer>
+#include <optional>
+
+#include "buffer.h"
+
+/**
+ * An append-only log of the edits on one file, kept under TempFiles::PATH.
+ * Each change of the buffer is encoded as a small binary record on the GUI thread,
+ * and the records are written in batches by a background thread.
+ * When the IDE crashes, the unsaved content is rebuilt by replaying the log on the file.
+ */
+class EditJournal : public QObject {
+    Q_OBJECT
+
+    QString filePath;
+    QString journalPath;
+    /** The content the journal is based on, that is, the content on the disk */
+    TextSnapshot base;
+    TextBuffer *buffer;
+    /** Records not written yet */
+    QByteArray records;
+    /** Bytes in the journal file (including the pending ones) */
+    qint64 journalSize;
+    bool created;
+    QTimer flushTimer;
+
+    /** Hand the pending records to the writer thread */
+    void writePending();
+    /** Rewrite the journal as a single snapshot of the current content */
+    void compact();
+
+private slots:
+    void onChanged(const TextChanges &changes);
+    void flush();
+
+public:
+    EditJournal(const QString &filePath, TextBuffer *buffer, QObject *parent = nullptr);
+    ~EditJournal() override;
+
+    /** The content is saved to the disk, so start over from the saved snapshot */
+    void rebase(const TextSnapshot &saved);
+    /** The changes are dropped by the user, remove the journal */
+    void discard();
+
+    static QString pathFor(const QString &filePath);
+    /** Replay the journal of the file, return nothing if there is nothing to recover */
+    static std::optional<QString> recover(const QString &filePath, const QString &diskContent);
+    /** Files with a journal left by a previous run */
+    static QStringList pending();
+};
+
+#endif // JOURNAL_H
@@ -5,6 +5,10 @@
 #include <qcoreapplication.h>
 #include <qcoro/qcoroprocess.h>
 
+#include "../util/metrics.h"
+#include "../util/trace.h"
+#include "../util/watchdog.h"
+
 // FIXME: this is linux only...?
 
 LSPUri LSPUri::fromQUrl(const QUrl &url) { return {QString("file://%1").arg(url.toEncoded())}; }
@@ -39,6 +43,17 @@ void LSPRange::readJson(QJsonObject json) {
 
 QJsonObject LSPPosition::toJson() const { return {{"line", line}, {"character", character}}; }
 
+QJsonObject LSPRange::toJson() const { return {{"start", start.toJson()}, {"end", end.toJson()}}; }
+
+QJsonObject LSPTextChange::toJson() const {
+    QJsonObject obj;
+    if (range.has_value()) {
+        obj["range"] = range->toJson();
+    }
+    obj["text"] = text;
+    return obj;
+}
+
 QPair<QString, QJsonValue> LSPPosition::toEntry() const { return {"position", toJson()}; }
 
 void InitializeResponse::parseJson(const QJsonObject &response) {
@@ -77,7 +92,9 @@ void DefinitionResponse::parseJson(const QJsonObject &response) {
     }
 }
 
-bool isNotification(LSPRequestMethod method) { return method == DidOpen; }
+bool isNotification(LSPRequestMethod method) {
+    return method == DidOpen || method == DidChange || method == DidClose;
+}
 
 QString LanguageServer::commentPrefix(Language language) {
     switch (language) {
@@ -96,6 +113,8 @@ const QMap<LSPRequestMethod, QString> methodMap = {
         {Initialize, "initialize"},
         {Shutdown, "shutdown"},
         {DidOpen, "textDocument/didOpen"},
+        {DidChange, "textDocument/didChange"},
+        {DidClose, "textDocument/didClose"},
         {Completion, "textDocument/completion"},
         {Definition, "textDocument/definition"},
         {Hover, "textDocument/hover"},
@@ -106,8 +125,21 @@ const QMap<LSPRequestMethod, QString> methodMap = {
         {DocumentSymbol, "textDocument/documentSymbol"}};
 
 
+static Counter &requestsSent() {
+    static auto &counter = Metrics::instance().counter(
+            "neverjudge_lsp_messages_total", "Messages sent to the language servers.");
+    return counter;
+}
+
+static Gauge &requestsInFlight() {
+    static auto &gauge = Metrics::instance().gauge(
+            "neverjudge_lsp_requests_in_flight", "Requests waiting for the language servers.");
+    return gauge;
+}
+
 void LanguageServer::sendRequest(LSPRequestMethod method, const QJsonObject &payload) const {
     static int requestId = 0;
+    WatchdogScope scope("LanguageServer::sendRequest");
 
     QJsonObject request;
     request["jsonrpc"] = "2.0";
@@ -124,12 +156,14 @@ void LanguageServer::sendRequest(LSPRequestMethod method, const QJsonObject &pay
     auto content = header.toUtf8() + data;
     // qDebug() << content;
     process->write(content);
+    requestsSent().add();
 
     // TODO: return the request ID and make sure of the corresponding between request and response
 }
 
 template<std::derived_from<LSPResponse> R>
 QCoro::Task<R> LanguageServer::waitResponse() const {
+    GaugeScope inFlight(requestsInFlight());
     auto pw = qCoro(process); // Coroutine wrapper for QProcess
     co_await pw.waitForReadyRead(3000);
     while (true) {
@@ -145,6 +179,7 @@ QCoro::Task<R> LanguageServer::waitResponse() const {
             }
 
             QByteArray data = co_await pw.read(length);
+            WatchdogScope scope("LanguageServer::readResponse");
             QJsonDocument doc = QJsonDocument::fromJson(data);
             QJsonObject json = doc.object();
 
@@ -168,6 +203,7 @@ QCoro::Task<R> LanguageServer::waitResponse() const {
 
 QCoro::Task<InitializeResponse> LanguageServer::initialize(const QString &rootUri,
                                                            const QJsonObject &capabilities) const {
+    TraceSpan span("lsp", "LanguageServer::initialize");
     QJsonObject payload = {
             {"processId", QCoreApplication::applicationPid()},
             {"rootUri", rootUri},
@@ -184,8 +220,26 @@ QCoro::Task<> LanguageServer::didOpen(const LSPTextDocument &document) const {
     co_return;
 }
 
+QCoro::Task<> LanguageServer::didChange(const LSPTextDocument &document,
+                                        const QList<LSPTextChange> &changes) const {
+    QJsonArray contentChanges;
+    for (const auto &change: changes) {
+        contentChanges.append(change.toJson());
+    }
+    QJsonObject payload = {document.toEntry(), {"contentChanges", contentChanges}};
+    sendRequest(DidChange, payload);
+    co_return;
+}
+
+QCoro::Task<> LanguageServer::didClose(const LSPTextDocument &document) const {
+    QJsonObject payload = {document.toEntry()};
+    sendRequest(DidClose, payload);
+    co_return;
+}
+
 QCoro::Task<CompletionResponse> LanguageServer::completion(const LSPTextDocument &document,
                                                            const LSPPosition &position) const {
+    TraceSpan span("lsp", "LanguageServer::completion");
     QJsonObject payload = {document.toEntry(), position.toEntry()};
     sendRequest(Completion, payload);
     auto response = co_await waitResponse<CompletionResponse>();
@@ -194,6 +248,7 @@ QCoro::Task<CompletionResponse> LanguageServer::completion(const LSPTextDocument
 
 QCoro::Task<DefinitionResponse> LanguageServer::definition(const LSPTextDocument &document,
                                                            const LSPPosition &position) const {
+    TraceSpan span("lsp", "LanguageServer::definition");
     QJsonObject payload = {document.toEntry(), position.toEntry()};
     sendRequest(Definition, payload);
     auto response = co_await waitResponse<DefinitionResponse>();
@@ -212,6 +267,7 @@ QCoro::Task<ClangdLanguageServer *> ClangdLanguageServer::getServer() {
 }
 
 QCoro::Task<> ClangdLanguageServer::start() {
+    TraceSpan span("lsp", "ClangdLanguageServer::start");
     QString serverName = "clangd";
     QStringList serverParams = {"--log=verbose"};
     process = new QProcess(this);
@@ -232,6 +288,7 @@ QCoro::Task<PylspLanguageServer *> PylspLanguageServer::getServer() {
 }
 
 QCoro::Task<> PylspLanguageServer::start() {
+    TraceSpan span("lsp", "PylspLanguageServer::start");
     // TODO: use pyright later?
     QString serverName = "pylsp";
     QStringList serverParams = {"-vv"};
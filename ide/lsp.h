@@ -15,6 +15,8 @@ enum LSPRequestMethod {
     Initialize,
     Shutdown,
     DidOpen,
+    DidChange,
+    DidClose,
     Completion,
     Definition,
     Hover,
@@ -56,6 +58,15 @@ struct LSPRange {
     LSPPosition end;
 
     void readJson(QJsonObject json);
+    QJsonObject toJson() const;
+};
+
+/** An edit of the document, the whole content is replaced when there is no range */
+struct LSPTextChange {
+    std::optional<LSPRange> range = std::nullopt;
+    QString text;
+
+    QJsonObject toJson() const;
 };
 
 struct LSPResponse {
@@ -154,6 +165,9 @@ public:
     QCoro::Task<CompletionResponse> completion(const LSPTextDocument &document,
                                                const LSPPosition &position) const;
     QCoro::Task<> didOpen(const LSPTextDocument &document) const;
+    QCoro::Task<> didChange(const LSPTextDocument &document,
+                            const QList<LSPTextChange> &changes) const;
+    QCoro::Task<> didClose(const LSPTextDocument &document) const;
     QCoro::Task<DefinitionResponse> definition(const LSPTextDocument &document,
                                                const LSPPosition &position) const;
     // TODO: support more functions in LSP
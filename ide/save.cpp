@@ -0,0 +1,66 @@
+#include "save.h"
+
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStringEncoder>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "../util/file.h"
+#include "../util/worker.h"
+
+using SaveOutcome = std::expected<void, QString>;
+
+/** Make the rename itself durable, QSaveFile only syncs the file content */
+static void syncDirectory(const QString &dir) {
+#ifdef Q_OS_UNIX
+    int fd = ::open(QFile::encodeName(dir).constData(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    ::fsync(fd);
+    ::close(fd);
+#else
+    Q_UNUSED(dir);
+#endif
+}
+
+static SaveOutcome writeSnapshot(const QString &path, const TextSnapshot &snapshot,
+                                 bool syncDir) {
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return std::unexpected(file.errorString());
+    }
+
+    QStringEncoder encoder(QStringEncoder::Utf8);
+    bool ok = true;
+    snapshot.forEachChunk([&](QStringView chunk) {
+        QByteArray data = encoder(chunk);
+        ok = file.write(data) == data.size();
+        return ok;
+    });
+    if (!ok) {
+        QString error = file.errorString();
+        file.cancelWriting();
+        return std::unexpected(error);
+    }
+    // commit flushes, fsyncs and renames the temporary file over the target
+    if (!file.commit()) {
+        return std::unexpected(file.errorString());
+    }
+    if (syncDir) {
+        syncDirectory(QFileInfo(path).absolutePath());
+    }
+    return {};
+}
+
+FileSaver::SaveResult FileSaver::save(const QString &path, const TextSnapshot &snapshot) {
+    // "file": sync the content before renaming, "full": also sync the directory entry
+    bool syncDir = Configs::instance().get("saveFsync").toString() == "full";
+
+    co_return co_await WorkerPool::instance().run(
+            [path, snapshot, syncDir] { return writeSnapshot(path, snapshot, syncDir); });
+}
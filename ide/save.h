@@ -0,0 +1,23 @@
+#ifndef SAVE_H
+#define SAVE_H
+
+#include <expected>
+#include <qcorotask.h>
+
+#include "buffer.h"
+
+/**
+ * Save files off the GUI thread.
+ * The content is written to a temporary file and renamed over the target (QSaveFile),
+ * so a crash in the middle of a save never leaves a truncated file behind.
+ */
+class FileSaver {
+public:
+    // When succeeded, return nothing, else return an error message
+    using SaveResult = QCoro::Task<std::expected<void, QString>>;
+
+    /** Encode the snapshot as UTF-8 and write it to the path on a worker thread */
+    static SaveResult save(const QString &path, const TextSnapshot &snapshot);
+};
+
+#endif // SAVE_H
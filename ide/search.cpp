@@ -0,0 +1,543 @@
+#include "search.h"
+
+#include <QCoreApplication>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QPointer>
+#include <cstring>
+
+#include "../util/worker.h"
+
+// matches are sent back when there are this many of them, or this much time (ms) passed
+#define BATCH_SIZE 4096
+#define BATCH_INTERVAL 30
+// files matched by one task of the project search
+#define FILES_PER_TASK 64
+// larger files are not searched, they are hardly source code
+#define MAX_FILE_SIZE (16 * 1024 * 1024)
+// a NUL byte in this many bytes from the beginning means a binary file, as git does
+#define BINARY_PROBE 8000
+#define MAX_MATCHES_PER_FILE 1000
+#define MAX_PROJECT_MATCHES 20000
+#define MAX_PREVIEW 200
+
+bool SearchQuery::isEmpty() const { return pattern.isEmpty(); }
+
+QRegularExpression SearchQuery::expression() const {
+    // ^ and $ match at every line, as in other editors
+    auto options = QRegularExpression::MultilineOption;
+    if (!caseSensitive) {
+        options |= QRegularExpression::CaseInsensitiveOption;
+    }
+    return QRegularExpression(pattern, options);
+}
+
+using MatchVisitor = std::function<void(qsizetype offset, qsizetype length,
+                                        const QRegularExpressionMatch *match)>;
+
+/** Visit the non-empty matches in order, until canceled */
+static void forEachMatch(const QString &text, const SearchQuery &query,
+                         const std::atomic_bool &canceled, const MatchVisitor &visit) {
+    if (!query.regex) {
+        auto cs = query.caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive;
+        auto length = query.pattern.length();
+        for (auto i = text.indexOf(query.pattern, 0, cs); i != -1 && !canceled;
+             i = text.indexOf(query.pattern, i + length, cs)) {
+            visit(i, length, nullptr);
+        }
+        return;
+    }
+    auto it = query.expression().globalMatch(text);
+    while (it.hasNext() && !canceled) {
+        auto match = it.next();
+        // empty matches (e.g. "^") have nothing to show or replace
+        if (match.capturedLength() > 0) {
+            visit(match.capturedStart(), match.capturedLength(), &match);
+        }
+    }
+}
+
+/** Run fn on the GUI thread, if the search is still alive and not canceled by then */
+template<class F>
+static void postBack(const QPointer<TextSearch> &self,
+                     const std::shared_ptr<std::atomic_bool> &token, F &&fn) {
+    QMetaObject::invokeMethod(
+            QCoreApplication::instance(),
+            [self, token, fn = std::forward<F>(fn)] {
+                if (self && !*token) {
+                    fn(self.data());
+                }
+            },
+            Qt::QueuedConnection);
+}
+
+TextSearch::TextSearch(QObject *parent) : QObject(parent) {}
+
+TextSearch::~TextSearch() { cancel(); }
+
+TextSearch::Token TextSearch::restart() {
+    cancel();
+    running = std::make_shared<std::atomic_bool>(false);
+    return running;
+}
+
+void TextSearch::cancel() {
+    if (running) {
+        *running = true;
+    }
+}
+
+void TextSearch::find(const TextSnapshot &snapshot, const SearchQuery &query) {
+    auto token = restart();
+    if (query.isEmpty() || (query.regex && !query.expression().isValid())) {
+        emit searchFinished(0);
+        return;
+    }
+    QPointer self(this);
+    WorkerPool::instance().post([self, token, snapshot, query] {
+        QString text = snapshot.text();
+        QList<TextMatch> batch;
+        int count = 0;
+        QElapsedTimer timer;
+        timer.start();
+
+        forEachMatch(text, query, *token, [&](qsizetype offset, qsizetype length, auto *) {
+            batch.append({offset, length});
+            count++;
+            if (batch.size() >= BATCH_SIZE || timer.elapsed() >= BATCH_INTERVAL) {
+                postBack(self, token, [batch = std::move(batch)](TextSearch *search) {
+                    emit search->matchesFound(batch);
+                });
+                batch = {};
+                timer.restart();
+            }
+        });
+        postBack(self, token, [batch = std::move(batch), count](TextSearch *search) {
+            if (!batch.isEmpty()) {
+                emit search->matchesFound(batch);
+            }
+            emit search->searchFinished(count);
+        });
+    });
+}
+
+void TextSearch::replaceAll(const TextSnapshot &snapshot, const SearchQuery &query,
+                            const QString &replacement) {
+    auto token = restart();
+    if (query.isEmpty() || (query.regex && !query.expression().isValid())) {
+        emit replaceReady(snapshot, 0, 0, {}, 0);
+        return;
+    }
+    QPointer self(this);
+    WorkerPool::instance().post([self, token, snapshot, query, replacement] {
+        QString text = snapshot.text();
+        // only the span from the first match to the end of the last one is rebuilt
+        QString result;
+        qsizetype from = -1, last = 0;
+        int count = 0;
+
+        forEachMatch(text, query, *token,
+                     [&](qsizetype offset, qsizetype length, const QRegularExpressionMatch *match) {
+                         if (from == -1) {
+                             from = last = offset;
+                         }
+                         result.append(QStringView(text).mid(last, offset - last));
+                         result.append(match ? replacementOf(*match, replacement) : replacement);
+                         last = offset + length;
+                         count++;
+                     });
+        from = qMax<qsizetype>(from, 0);
+        postBack(self, token,
+                 [snapshot, from, last, result = std::move(result), count](TextSearch *search) {
+                     emit search->replaceReady(snapshot, from, last, result, count);
+                 });
+    });
+}
+
+QString TextSearch::replacementOf(const QRegularExpressionMatch &match,
+                                  const QString &replacement) {
+    QString result;
+    result.reserve(replacement.length());
+    for (qsizetype i = 0; i < replacement.length(); ++i) {
+        QChar c = replacement.at(i);
+        if (c == '\\' && i + 1 < replacement.length()) {
+            QChar next = replacement.at(++i);
+            if (next.isDigit()) {
+                result.append(match.captured(next.digitValue()));
+            } else if (next == 'n') {
+                result.append('\n');
+            } else if (next == 't') {
+                result.append('\t');
+            } else {
+                result.append(next); // "\\" and other escaped characters
+            }
+            continue;
+        }
+        result.append(c);
+    }
+    return result;
+}
+
+/* Project search */
+
+struct IgnoreRule {
+    /** Folder of the .gitignore, relative to the root */
+    QString base;
+    QRegularExpression pattern;
+    /** Matched against the path from base, instead of the file name */
+    bool anchored;
+    bool negated;
+    bool dirOnly;
+};
+
+/** Translate a gitignore glob into a regular expression */
+static QRegularExpression globToRegex(QStringView glob) {
+    QString re = "^";
+    for (qsizetype i = 0; i < glob.size(); ++i) {
+        QChar c = glob[i];
+        if (c == '*' && i + 1 < glob.size() && glob[i + 1] == '*') {
+            i++;
+            if (i + 1 < glob.size() && glob[i + 1] == '/') {
+                i++;
+                re += "(?:.*/)?"; // "**/" matches any folders, or none
+            } else {
+                re += ".*";
+            }
+        } else if (c == '*') {
+            re += "[^/]*";
+        } else if (c == '?') {
+            re += "[^/]";
+        } else if (c == '[' && glob.indexOf(']', i + 1) != -1) {
+            auto close = glob.indexOf(']', i + 1);
+            auto set = glob.mid(i + 1, close - i - 1).toString();
+            if (set.startsWith('!')) {
+                set[0] = '^';
+            }
+            re += '[' + set + ']';
+            i = close;
+        } else if (c == '\\' && i + 1 < glob.size()) {
+            re += QRegularExpression::escape(glob.mid(++i, 1).toString());
+        } else {
+            re += QRegularExpression::escape(QString(c));
+        }
+    }
+    re += '$';
+    return QRegularExpression(re);
+}
+
+static QList<IgnoreRule> readGitignore(const QString &dir, const QString &base) {
+    QFile file(dir + "/.gitignore");
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return {};
+    }
+    QList<IgnoreRule> rules;
+    while (!file.atEnd()) {
+        QString line = QString::fromUtf8(file.readLine()).trimmed();
+        if (line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+        IgnoreRule rule{base, {}, false, false, false};
+        if (line.startsWith('!')) {
+            rule.negated = true;
+            line.remove(0, 1);
+        }
+        if (line.endsWith('/')) {
+            rule.dirOnly = true;
+            line.chop(1);
+        }
+        // a slash at the beginning or in the middle makes it relative to the .gitignore
+        rule.anchored = line.contains('/');
+        if (line.startsWith('/')) {
+            line.remove(0, 1);
+        }
+        if (line.isEmpty()) {
+            continue;
+        }
+        rule.pattern = globToRegex(line);
+        rules.append(rule);
+    }
+    return rules;
+}
+
+/** The last rule matching the path decides */
+static bool isIgnored(const QList<IgnoreRule> &rules, const QString &path, bool isDir) {
+    bool ignored = false;
+    for (const auto &rule: rules) {
+        if (rule.dirOnly && !isDir) {
+            continue;
+        }
+        QStringView subject = path;
+        if (!rule.base.isEmpty()) {
+            subject = subject.mid(rule.base.length() + 1);
+        }
+        if (!rule.anchored) {
+            subject = subject.mid(subject.lastIndexOf('/') + 1);
+        }
+        if (rule.pattern.matchView(subject).hasMatch()) {
+            ignored = !rule.negated;
+        }
+    }
+    return ignored;
+}
+
+/** Find the needle with memchr and memcmp, both vectorized by the C library */
+static const char *findBytes(const char *from, const char *end, const QByteArray &needle) {
+    const char first = needle.front();
+    const auto size = needle.size();
+    while (end - from >= size) {
+        auto *p = static_cast<const char *>(std::memchr(from, first, end - from - size + 1));
+        if (!p) {
+            return nullptr;
+        }
+        if (std::memcmp(p + 1, needle.constData() + 1, size - 1) == 0) {
+            return p;
+        }
+        from = p + 1;
+    }
+    return nullptr;
+}
+
+/** Keep the line of the last match, so matches in order are located in one pass */
+struct LineCursor {
+    qsizetype scanned = 0;
+    qsizetype lineStart = 0;
+    int line = 0;
+
+    void advance(const char *data, qsizetype offset) {
+        while (auto *nl = static_cast<const char *>(
+                       std::memchr(data + scanned, '\n', offset - scanned))) {
+            line++;
+            lineStart = nl - data + 1;
+            scanned = lineStart;
+        }
+        scanned = offset;
+    }
+
+    void advance(QStringView text, qsizetype offset) {
+        for (auto nl = text.indexOf(u'\n', scanned); nl != -1 && nl < offset;
+             nl = text.indexOf(u'\n', nl + 1)) {
+            line++;
+            lineStart = nl + 1;
+        }
+        scanned = offset;
+    }
+};
+
+static QString previewOf(QString line, int column) {
+    if (line.endsWith('\r')) {
+        line.chop(1);
+    }
+    if (line.length() <= MAX_PREVIEW) {
+        return line;
+    }
+    // keep some context before the match
+    auto start = qMax(0, column - MAX_PREVIEW / 4);
+    return (start > 0 ? "…" : "") + line.mid(start, MAX_PREVIEW) + "…";
+}
+
+struct ProjectSearch::Job {
+    QString root;
+    SearchQuery query;
+    /** UTF-8 pattern for the case-sensitive plain search, which runs on the raw bytes */
+    QByteArray needle;
+    /** Only touched on the GUI thread */
+    QPointer<ProjectSearch> owner;
+    std::atomic_bool canceled = false;
+    /** Set when there are too many matches, the matches found are still reported */
+    std::atomic_bool truncated = false;
+    /** The walk and the batches of files not finished */
+    std::atomic_int pending = 0;
+    std::atomic_int files = 0;
+    std::atomic_int matches = 0;
+
+    bool stopped() const { return canceled || truncated; }
+};
+
+static void searchFile(const SearchQuery &query, const QByteArray &needle,
+                       const std::atomic_bool &canceled, const QString &path,
+                       QList<FileMatch> &found) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly) || file.size() == 0 || file.size() > MAX_FILE_SIZE) {
+        return;
+    }
+    const auto size = file.size();
+    QByteArray fallback;
+    auto *data = reinterpret_cast<const char *>(file.map(0, size));
+    if (!data) {
+        fallback = file.readAll(); // some file systems cannot be mapped
+        data = fallback.constData();
+    }
+    if (std::memchr(data, 0, qMin<qint64>(size, BINARY_PROBE))) {
+        return;
+    }
+
+    LineCursor cursor;
+    int count = 0;
+    if (!query.regex && query.caseSensitive) {
+        const char *end = data + size;
+        for (auto *p = findBytes(data, end, needle); p && count < MAX_MATCHES_PER_FILE;
+             p = findBytes(p + needle.size(), end, needle), count++) {
+            cursor.advance(data, p - data);
+            auto *lineStart = data + cursor.lineStart;
+            auto *lineEnd = static_cast<const char *>(std::memchr(p, '\n', end - p));
+            lineEnd = lineEnd ? lineEnd : end;
+            int column = static_cast<int>(QString::fromUtf8(lineStart, p - lineStart).length());
+            QString line = QString::fromUtf8(lineStart, lineEnd - lineStart);
+            found.append({path, cursor.line, column, static_cast<int>(query.pattern.length()),
+                          previewOf(line, column)});
+        }
+        return;
+    }
+
+    QString text = QString::fromUtf8(data, size);
+    forEachMatch(text, query, canceled,
+                 [&](qsizetype offset, qsizetype length, const QRegularExpressionMatch *) {
+                     if (count++ >= MAX_MATCHES_PER_FILE) {
+                         return;
+                     }
+                     cursor.advance(text, offset);
+                     auto lineEnd = text.indexOf(u'\n', offset);
+                     lineEnd = lineEnd == -1 ? text.length() : lineEnd;
+                     int column = static_cast<int>(offset - cursor.lineStart);
+                     QString line = text.mid(cursor.lineStart, lineEnd - cursor.lineStart);
+                     found.append({path, cursor.line, column, static_cast<int>(length),
+                                   previewOf(line, column)});
+                 });
+}
+
+template<class F>
+void ProjectSearch::postToOwner(const std::shared_ptr<Job> &job, F &&fn) {
+    QMetaObject::invokeMethod(
+            QCoreApplication::instance(),
+            [job, fn = std::forward<F>(fn)] {
+                if (job->owner && !job->canceled) {
+                    fn(job->owner.data());
+                }
+            },
+            Qt::QueuedConnection);
+}
+
+ProjectSearch::ProjectSearch(QObject *parent) : QObject(parent) {}
+
+ProjectSearch::~ProjectSearch() { cancel(); }
+
+void ProjectSearch::start(const QString &root, const SearchQuery &query) {
+    cancel();
+    if (query.isEmpty() || (query.regex && !query.expression().isValid())) {
+        emit searchFinished(0, 0, false);
+        return;
+    }
+    running = std::make_shared<Job>();
+    running->root = QDir(root).absolutePath();
+    running->query = query;
+    running->needle = query.pattern.toUtf8();
+    running->owner = this;
+    running->pending = 1; // the walk
+    WorkerPool::instance().post([job = running] { walk(job); });
+}
+
+void ProjectSearch::cancel() {
+    if (running) {
+        running->canceled = true;
+        running.reset();
+    }
+}
+
+bool ProjectSearch::isRunning() const { return running != nullptr; }
+
+void ProjectSearch::walk(const std::shared_ptr<Job> &job) {
+    struct Folder {
+        QString path;
+        QString relative;
+        QList<IgnoreRule> rules;
+    };
+    QList<Folder> folders{{job->root, "", {}}};
+    QStringList files;
+
+    auto dispatch = [&job, &files] {
+        job->pending++;
+        WorkerPool::instance().post([job, files] { searchFiles(job, files); });
+        files.clear();
+    };
+
+    while (!folders.isEmpty() && !job->stopped()) {
+        auto folder = folders.takeLast();
+        folder.rules += readGitignore(folder.path, folder.relative);
+
+        QDirIterator it(folder.path, QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden);
+        while (it.hasNext()) {
+            auto info = it.nextFileInfo();
+            auto name = info.fileName();
+            auto relative = folder.relative.isEmpty() ? name : folder.relative + "/" + name;
+            // symbolic links to folders may loop, so only files are followed
+            if (info.isSymLink() && info.isDir()) {
+                continue;
+            }
+            bool isDir = info.isDir();
+            if (isDir && (name == ".git" || name == "build")) {
+                continue;
+            }
+            if (isIgnored(folder.rules, relative, isDir)) {
+                continue;
+            }
+            if (isDir) {
+                folders.append({info.filePath(), relative, folder.rules});
+            } else {
+                files.append(info.filePath());
+                if (files.size() >= FILES_PER_TASK) {
+                    dispatch();
+                }
+            }
+        }
+    }
+    if (!files.isEmpty()) {
+        dispatch();
+    }
+    finishOne(job);
+}
+
+void ProjectSearch::searchFiles(const std::shared_ptr<Job> &job, const QStringList &files) {
+    QList<FileMatch> found;
+    QElapsedTimer timer;
+    timer.start();
+    for (const auto &path: files) {
+        if (job->stopped()) {
+            break;
+        }
+        searchFile(job->query, job->needle, job->canceled, path, found);
+        job->files++;
+        // stream the matches of slow batches
+        if (!found.isEmpty() && timer.elapsed() >= BATCH_INTERVAL) {
+            if ((job->matches += static_cast<int>(found.size())) >= MAX_PROJECT_MATCHES) {
+                job->truncated = true;
+            }
+            postToOwner(job, [found = std::move(found)](ProjectSearch *search) {
+                emit search->matchesFound(found);
+            });
+            found = {};
+            timer.restart();
+        }
+    }
+    if (!found.isEmpty()) {
+        if ((job->matches += static_cast<int>(found.size())) >= MAX_PROJECT_MATCHES) {
+            job->truncated = true;
+        }
+        postToOwner(job, [found = std::move(found)](ProjectSearch *search) {
+            emit search->matchesFound(found);
+        });
+    }
+    finishOne(job);
+}
+
+void ProjectSearch::finishOne(const std::shared_ptr<Job> &job) {
+    if (--job->pending > 0) {
+        return;
+    }
+    postToOwner(job, [job](ProjectSearch *search) {
+        if (search->running == job) {
+            search->running.reset();
+        }
+        emit search->searchFinished(job->files, job->matches, job->truncated);
+    });
+}
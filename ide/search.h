@@ -0,0 +1,101 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <QObject>
+#include <QRegularExpression>
+#include <atomic>
+#include <memory>
+
+#include "buffer.h"
+
+struct SearchQuery {
+    QString pattern;
+    bool regex = false;
+    bool caseSensitive = false;
+
+    bool isEmpty() const;
+    /** The compiled pattern, only meaningful when regex is set */
+    QRegularExpression expression() const;
+};
+
+struct TextMatch {
+    qsizetype offset;
+    qsizetype length;
+};
+
+/**
+ * Find or replace in a snapshot on a worker thread.
+ * Matches are sent back in batches while searching, and starting a new search cancels the old one.
+ */
+class TextSearch : public QObject {
+    Q_OBJECT
+
+    using Token = std::shared_ptr<std::atomic_bool>;
+    Token running;
+
+    Token restart();
+
+signals:
+    /** A batch of matches, in the order of the text */
+    void matchesFound(const QList<TextMatch> &matches);
+    void searchFinished(int count);
+    /** [from, to) of the source should be replaced by text to replace all the matches */
+    void replaceReady(const TextSnapshot &source, qsizetype from, qsizetype to, const QString &text,
+                      int count);
+
+public:
+    explicit TextSearch(QObject *parent = nullptr);
+    ~TextSearch() override;
+
+    void find(const TextSnapshot &snapshot, const SearchQuery &query);
+    void replaceAll(const TextSnapshot &snapshot, const SearchQuery &query,
+                    const QString &replacement);
+    void cancel();
+
+    /** The replacement of one match, with \0 to \9 expanded for regex */
+    static QString replacementOf(const QRegularExpressionMatch &match, const QString &replacement);
+};
+
+struct FileMatch {
+    QString path;
+    int line;
+    int column;
+    int length;
+    /** The line of the match, shortened when it is too long */
+    QString preview;
+};
+
+/**
+ * Search the text files under a folder, except the ones ignored by .gitignore or under build/.
+ * One thread walks the folder while the others map the files and match them,
+ * and the matches of every file are sent back as soon as they are found.
+ */
+class ProjectSearch : public QObject {
+    Q_OBJECT
+
+    struct Job;
+    std::shared_ptr<Job> running;
+
+    static void walk(const std::shared_ptr<Job> &job);
+    static void searchFiles(const std::shared_ptr<Job> &job, const QStringList &files);
+    /** Called when the walk or a batch of files is done, the last one reports the end */
+    static void finishOne(const std::shared_ptr<Job> &job);
+    /** Run fn on the GUI thread, if the job is still wanted by then */
+    template<class F>
+    static void postToOwner(const std::shared_ptr<Job> &job, F &&fn);
+
+signals:
+    void matchesFound(const QList<FileMatch> &matches);
+    /** truncated is set when the search stopped at the limit of matches */
+    void searchFinished(int files, int matches, bool truncated);
+
+public:
+    explicit ProjectSearch(QObject *parent = nullptr);
+    ~ProjectSearch() override;
+
+    void start(const QString &root, const SearchQuery &query);
+    void cancel();
+    bool isRunning() const;
+};
+
+#endif // SEARCH_H
@@ -0,0 +1,64 @@
+#include "session.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+QString Session::pathOf(const QString &root) {
+    auto key = QDir(root).absolutePath().toUtf8();
+    auto name = QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex();
+    return QStandardPaths::writableLocation(QStandardPaths::ConfigLocation) +
+           "/never-judge/sessions/" + name + ".json";
+}
+
+SessionState Session::load(const QString &root) {
+    QFile file(pathOf(root));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+    QJsonParseError error;
+    auto obj = QJsonDocument::fromJson(file.readAll(), &error).object();
+    if (error.error != QJsonParseError::NoError) {
+        qWarning() << "Session: JSON parse error:" << error.errorString();
+        return {};
+    }
+
+    SessionState state;
+    for (const auto &value: obj["tabs"].toArray()) {
+        auto tab = value.toObject();
+        QString path = tab["path"].toString();
+        // the file may be gone since last time
+        if (QFileInfo::exists(path)) {
+            state.tabs.append({path, tab["cursor"].toInt(), tab["scroll"].toInt()});
+        }
+    }
+    state.current = qMin(obj["current"].toInt(-1), static_cast<int>(state.tabs.size()) - 1);
+    for (const auto &value: obj["recent"].toArray()) {
+        state.recent.append(value.toString());
+    }
+    return state;
+}
+
+void Session::save(const QString &root, const SessionState &state) {
+    QJsonArray tabs;
+    for (const auto &tab: state.tabs) {
+        tabs.append(QJsonObject{{"path", tab.path}, {"cursor", tab.cursor}, {"scroll", tab.scroll}});
+    }
+    QJsonObject obj{{"tabs", tabs},
+                    {"current", state.current},
+                    {"recent", QJsonArray::fromStringList(state.recent)}};
+
+    QString path = pathOf(root);
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Session: cannot save session:" << file.errorString();
+        return;
+    }
+    file.write(QJsonDocument(obj).toJson());
+    file.commit();
+}
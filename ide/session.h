@@ -0,0 +1,31 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <QList>
+#include <QString>
+
+struct TabState {
+    QString path;
+    int cursor = 0;
+    /** The first visible line */
+    int scroll = 0;
+};
+
+struct SessionState {
+    /** In the order of the tab bar */
+    QList<TabState> tabs;
+    int current = -1;
+    /** Paths of the tabs, the most recently used first */
+    QStringList recent;
+};
+
+/** The tabs opened in each project, stored in the config folder */
+class Session {
+    static QString pathOf(const QString &root);
+
+public:
+    static SessionState load(const QString &root);
+    static void save(const QString &root, const SessionState &state);
+};
+
+#endif // SESSION_H
@@ -2,6 +2,9 @@
 
 #include <QApplication>
 
+#include "util/metrics.h"
+#include "util/watchdog.h"
+
 #ifndef NDEBUG
 #include "util/file.h"
 #endif
@@ -14,6 +17,9 @@ int main(int argc, char *argv[]) {
 #endif
 
     QApplication app(argc, argv);
+    Watchdog::instance().start();
+    // written on exit, even if nothing was measured
+    Metrics::instance();
     auto *window = new IDEMainWindow();
 
     // open the running folder
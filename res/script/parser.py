@@ -7,16 +7,19 @@ try:
 except ImportError:
     raise ImportError("Please install BeautifulSoup4 using 'pip install beautifulsoup4'")
 
-if len(sys.argv) == 1:
-    file = "/tmp/never-judge/temp-problem"  # used for testing
+if len(sys.argv) > 1 and sys.argv[1] == "-":
+    content = sys.stdin.read()  # the page is piped in
 else:
-    file = sys.argv[1]
-if not os.path.exists(file):
-    sys.stderr.write(f"File {file} does not exist")
-    exit(1)
-
-with open(file, 'r', encoding='utf-8') as f:
-    content = f.read()
+    if len(sys.argv) == 1:
+        file = "/tmp/never-judge/temp-problem"  # used for testing
+    else:
+        file = sys.argv[1]
+    if not os.path.exists(file):
+        sys.stderr.write(f"File {file} does not exist")
+        exit(1)
+
+    with open(file, 'r', encoding='utf-8') as f:
+        content = f.read()
 
 soup = BeautifulSoup(content, 'html.parser')
 
@@ -22,12 +22,15 @@ def get_field(soup, name):
     return ''
 
 def main():
-    if len(sys.argv) == 1:
-        path = "/tmp/never-judge/temp-personalization"  # used for testing
+    if len(sys.argv) > 1 and sys.argv[1] == "-":
+        html = sys.stdin.read()  # the page is piped in
     else:
-        path = sys.argv[1]
-    with open(path, 'r', encoding='utf-8') as f:
-        html = f.read()
+        if len(sys.argv) == 1:
+            path = "/tmp/never-judge/temp-personalization"  # used for testing
+        else:
+            path = sys.argv[1]
+        with open(path, 'r', encoding='utf-8') as f:
+            html = f.read()
     soup = BeautifulSoup(html, 'html.parser')
 
     # 0: nickname  <- <input name="name">
@@ -3,7 +3,7 @@
 
 import sys
 import os
-import re
+import json
 
 try:
     from bs4 import BeautifulSoup
@@ -19,7 +19,8 @@ def parse_problem_detail(html_content):
     
     content_div = soup.find('div', class_='problem-content')
     if not content_div:
-        return "解析失败：找不到题目内容区域", "", "", "", "", ""
+        sys.stderr.write("解析失败：找不到题目内容区域")
+        sys.exit(1)
     
     sections = content_div.find_all('div', class_='section')
     
@@ -56,24 +57,35 @@ def parse_problem_detail(html_content):
         elif "提示" in section_title_text:
             hint = content_text
     
-    return title, description, input_desc, output_desc, sample_input, sample_output, hint
+    return {
+        "title": title,
+        "description": description,
+        "inputDesc": input_desc,
+        "outputDesc": output_desc,
+        "sampleInput": sample_input,
+        "sampleOutput": sample_output,
+        "hint": hint,
+    }
 
 def main():
-    if len(sys.argv) == 1:
-        file_path = "/tmp/never-judge/temp-problem_detail"  # used for testing
+    if len(sys.argv) > 1 and sys.argv[1] == "-":
+        content = sys.stdin.read()  # the page is piped in
     else:
-        file_path = sys.argv[1]
-    
-    if not os.path.exists(file_path):
-        sys.stderr.write(f"文件 {file_path} 不存在")
-        sys.exit(1)
-    
-    with open(file_path, 'r', encoding='utf-8') as f:
-        content = f.read()
+        if len(sys.argv) == 1:
+            file_path = "/tmp/never-judge/temp-problem_detail"  # used for testing
+        else:
+            file_path = sys.argv[1]
+
+        if not os.path.exists(file_path):
+            sys.stderr.write(f"文件 {file_path} 不存在")
+            sys.exit(1)
+
+        with open(file_path, 'r', encoding='utf-8') as f:
+            content = f.read()
     
     result = parse_problem_detail(content)
     
-    print("|".join(result))
+    print(json.dumps(result, ensure_ascii=False))
 
 if __name__ == "__main__":
     main()
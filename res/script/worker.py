@@ -0,0 +1,61 @@
+import contextlib
+import io
+import json
+import sys
+import traceback
+
+# imported once for all the scripts run here
+try:
+    import bs4  # noqa: F401
+except ImportError:
+    pass
+
+# one request per line: {"id", "name", "source", "args", "stdin"}
+# one response per line: {"id", "exitCode", "stdout", "stderr"}
+sys.stdin.reconfigure(encoding="utf-8")
+out = sys.stdout
+compiled = {}
+
+
+def run(request):
+    source = request["source"]
+    code = compiled.get(source)
+    if code is None:
+        code = compiled[source] = compile(source, request["name"], "exec")
+
+    stdout, stderr = io.StringIO(), io.StringIO()
+    exit_code = 0
+    sys.argv = [request["name"]] + request.get("args", [])
+    sys.stdin = io.StringIO(request.get("stdin", ""))
+    with contextlib.redirect_stdout(stdout), contextlib.redirect_stderr(stderr):
+        try:
+            exec(code, {"__name__": "__main__"})
+        except SystemExit as e:
+            if isinstance(e.code, int):
+                exit_code = e.code
+            elif e.code is not None:
+                stderr.write(str(e.code))
+                exit_code = 1
+        except BaseException:
+            traceback.print_exc()
+            exit_code = 1
+    return {
+        "id": request["id"],
+        "exitCode": exit_code,
+        "stdout": stdout.getvalue(),
+        "stderr": stderr.getvalue(),
+    }
+
+
+pipe = sys.stdin
+while True:
+    line = pipe.readline()
+    if not line:
+        break  # the application closed the pipe
+    request = json.loads(line)
+    try:
+        response = run(request)
+    except BaseException as e:
+        response = {"id": request.get("id"), "exitCode": 1, "stdout": "", "stderr": repr(e)}
+    out.write(json.dumps(response) + "\n")
+    out.flush()
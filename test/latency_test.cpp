@@ -0,0 +1,91 @@
+// Type a character in the editor and check the sample of the latency probe covers the highlight
+// and the completion of the edit, not only the paint after it.
+
+#include <QApplication>
+#include <QEventLoop>
+#include <QFile>
+#include <QKeyEvent>
+#include <QStandardPaths>
+#include <QSyntaxHighlighter>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QTimer>
+#include <optional>
+
+#include "../widgets/code.h"
+
+// ctest reports the test as skipped on this code
+#define SKIP_CODE 77
+#define SAMPLE_TIMEOUT 5000 // ms
+
+int main(int argc, char *argv[]) {
+    // the editor needs a GUI application, but no screen
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    // the configs and the caches of the user are left alone
+    QStandardPaths::setTestModeEnabled(true);
+    QApplication app(argc, argv);
+
+    QTemporaryDir dir;
+    QString path = dir.filePath("main.cpp");
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        QTextStream(stderr) << "cannot write " << path << '\n';
+        return 1;
+    }
+    QByteArray source = "int main() {\n    int value = 0;\n    return val\n}\n";
+    file.write(source);
+    file.close();
+
+    auto *edit = new CodeEditWidget(path);
+    if (!edit->document()->findChild<QSyntaxHighlighter *>()) {
+        QTextStream(stdout) << "no tree-sitter grammar of C++, nothing is highlighted\n";
+        return SKIP_CODE;
+    }
+    edit->resize(640, 480);
+    edit->show();
+    // the first paint of the editor, which belongs to no keystroke
+    QCoreApplication::processEvents();
+
+    QTextCursor cursor = edit->textCursor();
+    cursor.setPosition(static_cast<int>(source.lastIndexOf("val") + 3));
+    edit->setTextCursor(cursor);
+
+    std::optional<LatencySample> sample;
+    QEventLoop loop;
+    QObject::connect(&LatencyProbe::instance(), &LatencyProbe::sampleRecorded, &loop,
+                     [&](const LatencySample &recorded) {
+                         sample = recorded;
+                         loop.quit();
+                     });
+    QTimer::singleShot(SAMPLE_TIMEOUT, &loop, &QEventLoop::quit);
+    QKeyEvent press(QEvent::KeyPress, Qt::Key_U, Qt::NoModifier, "u");
+    QCoreApplication::sendEvent(edit, &press);
+    loop.exec();
+
+    int failures = 0;
+    if (!sample.has_value()) {
+        QTextStream(stderr) << "no sample recorded for the key\n";
+        ++failures;
+    } else {
+        for (auto phase: {LatencyPhase::Highlight, LatencyPhase::Completion}) {
+            if (sample->phases[static_cast<int>(phase)] <= 0) {
+                QTextStream(stderr) << "no time recorded for " << LatencyProbe::phaseName(phase)
+                                    << '\n';
+                ++failures;
+            }
+        }
+        if (sample->total <= 0) {
+            QTextStream(stderr) << "no total time recorded\n";
+            ++failures;
+        }
+    }
+    delete edit;
+    if (failures > 0) {
+        QTextStream(stderr) << failures << " checks failed\n";
+        return 1;
+    }
+    QTextStream(stdout) << "all checks passed\n";
+    return 0;
+}
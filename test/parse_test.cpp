@@ -0,0 +1,161 @@
+// Run the native extractors over pages written after the markup of OJ, not captured from it, with
+// the cases the tokenizer must survive. A failed check is printed and fails the test.
+
+#include <QFile>
+#include <QTextStream>
+
+#include "../web/extract.h"
+
+static int failures = 0;
+
+#define CHECK(condition)                                                                           \
+    do {                                                                                           \
+        if (!(condition)) {                                                                        \
+            QTextStream(stderr) << __FILE__ << ':' << __LINE__ << ": " << #condition << '\n';      \
+            ++failures;                                                                            \
+        }                                                                                          \
+    } while (false)
+
+#define CHECK_EQ(actual, expected)                                                                 \
+    do {                                                                                           \
+        auto a = (actual);                                                                         \
+        auto e = (expected);                                                                       \
+        if (a != e) {                                                                              \
+            QTextStream(stderr) << __FILE__ << ':' << __LINE__ << ": " << #actual << "\n  got      " \
+                                << a << "\n  expected " << e << '\n';                              \
+            ++failures;                                                                            \
+        }                                                                                          \
+    } while (false)
+
+static HtmlDocument fixture(const QString &name) {
+    QFile file(QString(FIXTURES_DIR) + '/' + name);
+    if (!file.open(QIODevice::ReadOnly)) {
+        QTextStream(stderr) << "cannot read fixture " << file.fileName() << '\n';
+        ++failures;
+        return HtmlDocument(QString());
+    }
+    // the crawler hands the parsers UTF-8 whatever the charset of the page
+    return HtmlDocument(QString::fromUtf8(file.readAll()));
+}
+
+static void testProblem() {
+    auto problem = OJExtractor::problem(fixture("problem.html"));
+    CHECK(problem.has_value());
+    if (!problem.has_value()) {
+        return;
+    }
+    // not the title written in the script of the head
+    CHECK_EQ(problem->title, QString("1:A+B问题"));
+    CHECK(problem->content.startsWith("<style>"));
+    CHECK(problem->content.contains(R"(<dl class="problem-content">)"));
+    CHECK(problem->content.trimmed().endsWith("</dl>"));
+    CHECK(!problem->content.contains("style=\""));
+    CHECK(!problem->content.contains("problem-params"));
+    // the source is kept as it is, the entities included
+    CHECK(problem->content.contains("&lt; 10<sup>9</sup>"));
+    CHECK(problem->content.contains("<pre>3</pre>"));
+}
+
+static void testMatch() {
+    auto match = OJExtractor::match(fixture("match.html"));
+    CHECK(match.has_value());
+    if (!match.has_value()) {
+        return;
+    }
+    // the cells left open are closed by the next one, and a cell of two classes still matches
+    QList<QUrl> expected = {QUrl("/hw01/1/"), QUrl("/hw01/2/"), QUrl("/hw01/3/")};
+    CHECK_EQ(match->problemUrls.size(), expected.size());
+    CHECK(match->problemUrls == expected);
+}
+
+static void testSubmitForm() {
+    auto form = OJExtractor::submitForm(fixture("submit.html"));
+    CHECK(form.has_value());
+    if (!form.has_value()) {
+        return;
+    }
+    CHECK_EQ(form->contestId, QString("12345"));
+    CHECK_EQ(form->problemNumber, QString("1"));
+    CHECK_EQ(form->languages.size(), 3);
+    if (form->languages.size() == 3) {
+        CHECK_EQ(form->languages[0].formValue, QString("G++"));
+        CHECK_EQ(form->languages[0].name, QString("G++(9.3(with c++17))"));
+        CHECK_EQ(form->languages[1].formValue, QString("GCC"));
+        CHECK_EQ(form->languages[1].name, QString("GCC(9.3)"));
+        CHECK_EQ(form->languages[2].formValue, QString("Python3"));
+        CHECK_EQ(form->languages[2].name, QString("Python3"));
+    }
+}
+
+static void testSubmitResponse() {
+    auto response = OJExtractor::submitResponse(fixture("submit_response.html"));
+    CHECK(response.has_value());
+    if (!response.has_value()) {
+        return;
+    }
+    CHECK(response->result == OJSubmitResponse::CE);
+    // the message of the compiler, without the source submitted
+    CHECK_EQ(response->message,
+             QString("Main.cpp: In function 'int main()':\n"
+                     "Main.cpp:3:5: error: 'cout' was not declared in this scope\n"));
+
+    CHECK(OJExtractor::resultOf("Accepted") == OJSubmitResponse::AC);
+    CHECK(OJExtractor::resultOf("Waiting") == OJSubmitResponse::W);
+    CHECK(OJExtractor::resultOf("Output Limit Exceeded") == OJSubmitResponse::UKE);
+}
+
+static void testProblemDetail() {
+    auto detail = OJExtractor::problemDetail(fixture("problem_detail.html"));
+    CHECK(detail.has_value());
+    if (!detail.has_value()) {
+        return;
+    }
+    CHECK_EQ(detail->title, QString("A+B问题"));
+    CHECK_EQ(detail->description, QString("输入两个整数，输出它们的和。"));
+    CHECK_EQ(detail->inputDesc, QString("两个整数 a, b。"));
+    CHECK_EQ(detail->outputDesc, QString("a+b 的值。"));
+    CHECK_EQ(detail->sampleInput, QString("1 2"));
+    CHECK_EQ(detail->sampleOutput, QString("3"));
+    CHECK_EQ(detail->hint, QString("注意 a+b 可能溢出 int & 要用 long long"));
+}
+
+static void testPersonalizationForm() {
+    auto form = OJExtractor::personalizationForm(fixture("personalization.html"));
+    CHECK(form.has_value());
+    if (!form.has_value()) {
+        return;
+    }
+    CHECK_EQ(form->nickname, QString("小明"));
+    CHECK_EQ(form->name, QString("王小明"));
+    CHECK_EQ(form->description, QString("热爱算法 & 编程"));
+    CHECK(form->gender == OJPersonalizationForm::Female);
+    CHECK_EQ(form->birthday, QString("2004-05-06"));
+    CHECK_EQ(form->city, QString("北京"));
+    CHECK_EQ(form->school, QString("北京大学"));
+}
+
+static void testWrongPage() {
+    // any page but the one expected is an error, for the script to have a try
+    auto page = fixture("match.html");
+    CHECK(!OJExtractor::problem(page).has_value());
+    CHECK(!OJExtractor::submitForm(page).has_value());
+    CHECK(!OJExtractor::submitResponse(page).has_value());
+    CHECK(!OJExtractor::problemDetail(page).has_value());
+    CHECK(!OJExtractor::personalizationForm(page).has_value());
+}
+
+int main() {
+    testProblem();
+    testMatch();
+    testSubmitForm();
+    testSubmitResponse();
+    testProblemDetail();
+    testPersonalizationForm();
+    testWrongPage();
+    if (failures > 0) {
+        QTextStream(stderr) << failures << " checks failed\n";
+        return 1;
+    }
+    QTextStream(stdout) << "all checks passed\n";
+    return 0;
+}
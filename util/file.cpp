@@ -7,6 +7,8 @@
 #include <QStandardPaths>
 #include <qcoro/qcoroprocess.h>
 
+#include "watchdog.h"
+
 QFile loadRes(const QString &path) { return QFile(":/res/" + path); }
 
 QIcon loadIcon(const QString &path) { return QIcon(":/res/" + path); }
@@ -25,6 +27,7 @@ QString loadText(const QString &path) {
 
 const QString TempFiles::PATH =
         QStandardPaths::writableLocation(QStandardPaths::TempLocation) + "/never-judge";
+const QString TempFiles::JOURNAL_PATH = TempFiles::PATH + "/journal";
 #define TempFileName(id) (PATH + "/temp" + (id.isEmpty() ? "" : "-") + id)
 
 TempFiles::TempId TempFiles::genID(const QString &filename) {
@@ -71,7 +74,17 @@ void TempFiles::clearCache() {
         return;
     }
     dir.setPath(PATH);
-    dir.removeRecursively();
+    // keep the journals, the unsaved work of a crashed run is recovered from them
+    for (const auto &info: dir.entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot)) {
+        if (info.absoluteFilePath() == QFileInfo(JOURNAL_PATH).absoluteFilePath()) {
+            continue;
+        }
+        if (info.isDir()) {
+            QDir(info.absoluteFilePath()).removeRecursively();
+        } else {
+            QFile::remove(info.absoluteFilePath());
+        }
+    }
     qDebug() << "TempFiles::cleared cache:" << PATH;
 }
 
@@ -191,6 +204,7 @@ void Configs::checkChangedConfig(const QJsonObject &newConfig) {
 }
 
 void Configs::saveConfig(const QJsonObject &config) {
+    WatchdogScope scope("Configs::saveConfig");
     QFile file(PATH);
     if (!file.open(QIODevice::WriteOnly)) {
         qWarning() << "Configs: Cannot save config file:" << file.errorString();
@@ -13,6 +13,8 @@ QString loadText(const QString &path);
 class TempFiles {
 public:
     static const QString PATH;
+    /** Edit journals live here, they must survive a crash of the IDE */
+    static const QString JOURNAL_PATH;
 
     using TempId = QString;
 
@@ -0,0 +1,142 @@
+#include "latency.h"
+
+#include <QFile>
+#include <QTextStream>
+#include <QTimer>
+#include <algorithm>
+
+// upper bounds of the histogram buckets in ms, 16 and 33 are one and two frames at 60 Hz
+static constexpr std::array<double, 10> BUCKET_BOUNDS = {1, 2, 4, 8, 16, 33, 50, 100, 250, 500};
+// one frame at 60 Hz, the paint of a handled key is requested before it ends
+#define FRAME_INTERVAL 16 // ms
+
+LatencyProbe::LatencyProbe() {
+    clock.start();
+    frameTimer.setSingleShot(true);
+    frameTimer.setInterval(FRAME_INTERVAL);
+    connect(&frameTimer, &QTimer::timeout, this, [this] {
+        if (!finishing) {
+            pending = false;
+        }
+    });
+}
+
+LatencyProbe &LatencyProbe::instance() {
+    static LatencyProbe probe;
+    return probe;
+}
+
+QString LatencyProbe::phaseName(LatencyPhase phase) {
+    switch (phase) {
+        case LatencyPhase::Highlight:
+            return tr("高亮");
+        case LatencyPhase::ExtraSelections:
+            return tr("选区");
+        case LatencyPhase::LineNumbers:
+            return tr("行号");
+        case LatencyPhase::Completion:
+            return tr("补全");
+    }
+    return {};
+}
+
+qint64 LatencyProbe::now() const { return clock.nsecsElapsed(); }
+
+bool LatencyProbe::keyPressed() {
+    // keys repeated before a paint belong to the first one, which waits the longest
+    if (pending) {
+        return false;
+    }
+    pending = true;
+    keyTime = now();
+    current = LatencySample();
+    return true;
+}
+
+void LatencyProbe::keyHandled(bool started, bool changed) {
+    if (!started) {
+        return;
+    }
+    if (!changed) {
+        pending = false; // a modifier or an ignored key, nothing is painted for it
+        return;
+    }
+    frameTimer.start();
+}
+
+void LatencyProbe::addPhase(LatencyPhase phase, qint64 nsecs) {
+    if (pending) {
+        current.phases[static_cast<int>(phase)] += nsecs;
+    }
+}
+
+void LatencyProbe::painted() {
+    if (!pending || finishing) {
+        return;
+    }
+    finishing = true;
+    frameTimer.stop();
+    QTimer::singleShot(0, this, &LatencyProbe::finish);
+}
+
+void LatencyProbe::finish() {
+    pending = false;
+    finishing = false;
+    current.total = now() - keyTime;
+
+    double ms = static_cast<double>(current.total) / 1e6;
+    auto bucket = std::lower_bound(BUCKET_BOUNDS.cbegin(), BUCKET_BOUNDS.cend(), ms);
+    ++histogram[bucket - BUCKET_BOUNDS.cbegin()];
+    for (int i = 0; i < LATENCY_PHASES; ++i) {
+        phaseTotals[i] += current.phases[i];
+    }
+    totalTime += current.total;
+    ++count;
+    emit sampleRecorded(current);
+}
+
+double LatencyProbe::percentile(double ratio) const {
+    if (count == 0) {
+        return 0;
+    }
+    int seen = 0;
+    for (size_t i = 0; i < BUCKET_BOUNDS.size(); ++i) {
+        seen += histogram[i];
+        if (seen >= ratio * count) {
+            return BUCKET_BOUNDS[i];
+        }
+    }
+    return qInf();
+}
+
+bool LatencyProbe::exportTo(const QString &path) const {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        qWarning() << "LatencyProbe: cannot write" << path << file.errorString();
+        return false;
+    }
+    QTextStream out(&file);
+    out << "# keystroke to paint latency, " << count << " samples\n";
+    out << "# bucket_ms\tcount\n";
+    for (size_t i = 0; i < histogram.size(); ++i) {
+        out << (i < BUCKET_BOUNDS.size() ? QString::number(BUCKET_BOUNDS[i]) : "+Inf") << '\t'
+            << histogram[i] << '\n';
+    }
+    if (count > 0) {
+        out << "# mean_ms\n";
+        out << "total\t" << static_cast<double>(totalTime) / count / 1e6 << '\n';
+        for (int i = 0; i < LATENCY_PHASES; ++i) {
+            out << phaseName(static_cast<LatencyPhase>(i)) << '\t'
+                << static_cast<double>(phaseTotals[i]) / count / 1e6 << '\n';
+        }
+    }
+    return true;
+}
+
+LatencyScope::LatencyScope(LatencyPhase phase) :
+    phase(phase), start(LatencyProbe::instance().now()) {}
+
+LatencyScope::~LatencyScope() {
+    auto &probe = LatencyProbe::instance();
+    probe.addPhase(phase, probe.now() - start);
+}
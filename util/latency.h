@@ -0,0 +1,78 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+#include <array>
+
+/** The work of the editor between a key press and the paint showing it */
+enum class LatencyPhase { Highlight, ExtraSelections, LineNumbers, Completion };
+
+constexpr int LATENCY_PHASES = 4;
+
+struct LatencySample {
+    /** From the key press to the end of the paint, in ns */
+    qint64 total = 0;
+    std::array<qint64, LATENCY_PHASES> phases{};
+};
+
+/**
+ * Measure how long a keystroke takes to show on the screen.
+ * A key press starts a sample, the phases add their time to it, and it is finished once the
+ * paint cycle of the editor after it is done (line numbers included). A key that changed neither
+ * the text nor the cursor, such as a lone Shift, is no sample.
+ * Samples are counted in a histogram, nothing is kept per keystroke.
+ */
+class LatencyProbe : public QObject {
+    Q_OBJECT
+
+    QElapsedTimer clock;
+    /** Drops a sample no paint followed, which shows nothing to the user */
+    QTimer frameTimer;
+    bool pending = false;
+    bool finishing = false;
+    qint64 keyTime = 0;
+    LatencySample current;
+
+    /** Samples under each bound (ms), the last bucket holds the rest */
+    std::array<int, 11> histogram{};
+    std::array<qint64, LATENCY_PHASES> phaseTotals{};
+    qint64 totalTime = 0;
+    int count = 0;
+
+    LatencyProbe();
+    void finish();
+
+signals:
+    void sampleRecorded(const LatencySample &sample);
+
+public:
+    static LatencyProbe &instance();
+    static QString phaseName(LatencyPhase phase);
+
+    /** Return if the key started a sample, a key pressed before the paint of the last does not */
+    bool keyPressed();
+    /** The editor handled the key, the sample it started is dropped if nothing changed */
+    void keyHandled(bool started, bool changed);
+    void addPhase(LatencyPhase phase, qint64 nsecs);
+    /** The editor painted, the sample ends after the other widgets painted too */
+    void painted();
+    qint64 now() const;
+    /** The upper bound (ms) of the bucket where the ratio of the samples is reached */
+    double percentile(double ratio) const;
+    /** Write the histogram and the mean of the phases as text, return if succeeded */
+    bool exportTo(const QString &path) const;
+};
+
+/** Add the time spent in the scope to a phase of the pending sample */
+class LatencyScope {
+    LatencyPhase phase;
+    qint64 start;
+
+public:
+    explicit LatencyScope(LatencyPhase phase);
+    ~LatencyScope();
+};
+
+#endif // LATENCY_H
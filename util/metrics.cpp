@@ -0,0 +1,129 @@
+#include "metrics.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QSysInfo>
+#include <QTextStream>
+#include <algorithm>
+
+Histogram::Histogram(std::vector<double> bounds) :
+    bounds(std::move(bounds)), buckets(new std::atomic<qint64>[this->bounds.size() + 1]) {
+    for (size_t i = 0; i <= this->bounds.size(); ++i) {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::observe(double value) {
+    auto bucket = std::lower_bound(bounds.cbegin(), bounds.cend(), value) - bounds.cbegin();
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+}
+
+Metrics::Metrics() {
+    // on exit rather than in the destructor, the other singletons may be gone by then
+    if (auto *app = QCoreApplication::instance()) {
+        moveToThread(app->thread());
+        connect(app, &QCoreApplication::aboutToQuit, this, [this] { exportTo(exitPath()); });
+    }
+}
+
+Metrics &Metrics::instance() {
+    static Metrics metrics;
+    return metrics;
+}
+
+QString Metrics::exitPath() {
+    return QStandardPaths::writableLocation(QStandardPaths::ConfigLocation) +
+           "/never-judge/metrics.prom";
+}
+
+Metrics::Entry &Metrics::entry(const QString &name, const QString &help) {
+    auto &entry = entries[name];
+    if (entry.help.isEmpty()) {
+        entry.help = help;
+    }
+    return entry;
+}
+
+Counter &Metrics::counter(const QString &name, const QString &help) {
+    QMutexLocker locker(&mutex);
+    auto &counter = entry(name, help).counter;
+    if (!counter) {
+        counter = std::make_unique<Counter>();
+    }
+    return *counter;
+}
+
+Gauge &Metrics::gauge(const QString &name, const QString &help) {
+    QMutexLocker locker(&mutex);
+    auto &gauge = entry(name, help).gauge;
+    if (!gauge) {
+        gauge = std::make_unique<Gauge>();
+    }
+    return *gauge;
+}
+
+Histogram &Metrics::histogram(const QString &name, const QString &help,
+                              std::vector<double> bounds) {
+    QMutexLocker locker(&mutex);
+    auto &histogram = entry(name, help).histogram;
+    if (!histogram) {
+        histogram = std::make_unique<Histogram>(std::move(bounds));
+    }
+    return *histogram;
+}
+
+QString Metrics::snapshot() {
+    QString text;
+    QTextStream out(&text);
+    // tells the installs apart when the snapshots are collected
+    out << "# HELP neverjudge_info The machine the snapshot was taken on.\n";
+    out << "# TYPE neverjudge_info gauge\n";
+    out << "neverjudge_info{host=\"" << QSysInfo::machineHostName() << "\",os=\""
+        << QSysInfo::prettyProductName() << "\",qt=\"" << qVersion() << "\"} 1\n";
+
+    QMutexLocker locker(&mutex);
+    for (const auto &[name, entry]: entries) {
+        out << "# HELP " << name << ' ' << entry.help << '\n';
+        if (entry.counter) {
+            out << "# TYPE " << name << " counter\n";
+            out << name << ' ' << entry.counter->value() << '\n';
+        } else if (entry.gauge) {
+            out << "# TYPE " << name << " gauge\n";
+            out << name << ' ' << entry.gauge->value() << '\n';
+        } else if (entry.histogram) {
+            const auto &histogram = *entry.histogram;
+            out << "# TYPE " << name << " histogram\n";
+            // the buckets of the format are cumulative
+            qint64 seen = 0;
+            for (size_t i = 0; i < histogram.bounds.size(); ++i) {
+                seen += histogram.buckets[i].load(std::memory_order_relaxed);
+                out << name << "_bucket{le=\"" << histogram.bounds[i] << "\"} " << seen << '\n';
+            }
+            seen += histogram.buckets[histogram.bounds.size()].load(std::memory_order_relaxed);
+            out << name << "_bucket{le=\"+Inf\"} " << seen << '\n';
+            out << name << "_sum " << histogram.sum.load(std::memory_order_relaxed) << '\n';
+            out << name << "_count " << histogram.count.load(std::memory_order_relaxed) << '\n';
+        }
+    }
+    return text;
+}
+
+bool Metrics::exportTo(const QString &path) {
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        qWarning() << "Metrics: cannot write" << path << file.errorString();
+        return false;
+    }
+    file.write(snapshot().toUtf8());
+    if (!file.commit()) {
+        qWarning() << "Metrics: cannot write" << path << file.errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,95 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+
+/** Only goes up, such as the bytes fetched */
+class Counter {
+    std::atomic<qint64> count = 0;
+
+public:
+    void add(qint64 n = 1) { count.fetch_add(n, std::memory_order_relaxed); }
+    qint64 value() const { return count.load(std::memory_order_relaxed); }
+};
+
+/** Goes up and down, such as the open documents */
+class Gauge {
+    std::atomic<qint64> current = 0;
+
+public:
+    void add(qint64 n) { current.fetch_add(n, std::memory_order_relaxed); }
+    void set(qint64 n) { current.store(n, std::memory_order_relaxed); }
+    qint64 value() const { return current.load(std::memory_order_relaxed); }
+};
+
+/** Add one to a gauge for the lifetime of the scope, safe to keep across co_await */
+class GaugeScope {
+    Gauge &gauge;
+
+public:
+    explicit GaugeScope(Gauge &gauge) : gauge(gauge) { gauge.add(1); }
+    ~GaugeScope() { gauge.add(-1); }
+    GaugeScope(const GaugeScope &) = delete;
+    GaugeScope &operator=(const GaugeScope &) = delete;
+};
+
+/** Counts the observations under each bound, such as the parse time in ms */
+class Histogram {
+    std::vector<double> bounds;
+    /** One more than the bounds, the last one holds the rest */
+    std::unique_ptr<std::atomic<qint64>[]> buckets;
+    std::atomic<double> sum = 0;
+    std::atomic<qint64> count = 0;
+
+    friend class Metrics;
+
+public:
+    explicit Histogram(std::vector<double> bounds);
+    void observe(double value);
+};
+
+/**
+ * All the counters, gauges and histograms of the application, registered by name.
+ * Registering locks, so keep the returned reference, such as in a static local.
+ * Updating is a relaxed atomic add.
+ * The snapshot is written in the Prometheus text format on demand and on exit.
+ */
+class Metrics : public QObject {
+    Q_OBJECT
+
+    struct Entry {
+        QString help;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+    };
+
+    QMutex mutex;
+    /** Sorted by name, so the snapshots of two installs diff well */
+    std::map<QString, Entry> entries;
+
+    Metrics();
+    Entry &entry(const QString &name, const QString &help);
+
+public:
+    static Metrics &instance();
+    /** Where the snapshot is written on exit */
+    static QString exitPath();
+
+    Counter &counter(const QString &name, const QString &help);
+    Gauge &gauge(const QString &name, const QString &help);
+    /** The bounds of a histogram are fixed by the first registration */
+    Histogram &histogram(const QString &name, const QString &help, std::vector<double> bounds);
+
+    QString snapshot();
+    /** Write the snapshot, return if succeeded */
+    bool exportTo(const QString &path);
+};
+
+#endif // METRICS_H
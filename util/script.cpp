@@ -1,36 +1,190 @@
 #include "script.h"
 
-#include <QProcess>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <qcoro/qcorofuture.h>
 #include <qcoro/qcoroprocess.h>
 
 #include "file.h"
+#include "metrics.h"
+#include "task.h"
+#include "trace.h"
+#include "watchdog.h"
+
+// a script running longer is stuck, its worker is killed
+#define SCRIPT_TIMEOUT 30000 // ms
 
 ScriptResult ScriptResult::fail() { return {false}; }
 ScriptResult ScriptResult::ok(int exitCode, const QString &stdOut, const QString &stdErr) {
     return {true, exitCode, stdOut, stdErr};
 }
 
-QCoro::Task<ScriptResult> runPythonScript(QFile &script, QStringList args) {
-    if (!script.open(QIODevice::ReadOnly)) {
-        qWarning() << "Failed to read script: " << script.fileName();
-        co_return ScriptResult::fail();
+static Counter &spawns() {
+    static auto &counter = Metrics::instance().counter("neverjudge_python_spawns_total",
+                                                       "Python processes started.");
+    return counter;
+}
+
+ScriptWorker::ScriptWorker(QObject *parent) : QObject(parent) {
+    timeout.setSingleShot(true);
+    timeout.setInterval(SCRIPT_TIMEOUT);
+    connect(&timeout, &QTimer::timeout, this, [this] {
+        qWarning() << "Script cost too long time, restarting its worker";
+        process.kill();
+    });
+    connect(&process, &QProcess::readyReadStandardOutput, this, &ScriptWorker::readResponses);
+    connect(&process, &QProcess::readyReadStandardError, this, [this] {
+        qWarning() << "Script worker:" << process.readAllStandardError();
+    });
+    connect(&process, &QProcess::finished, this, [this] {
+        // crashed or killed, the script in it never answers
+        reply(ScriptResult::fail());
+    });
+}
+
+ScriptWorker::~ScriptWorker() {
+    process.disconnect(this);
+    // the worker leaves once its stdin is closed
+    process.closeWriteChannel();
+    if (!process.waitForFinished(1000)) {
+        process.kill();
+        process.waitForFinished();
     }
-    QTextStream in(&script);
-    QString content = in.readAll();
+}
 
-    auto process = QProcess();
-    co_await qCoro(process).start("python", QStringList() << "-c" << content << args);
+QCoro::Task<bool> ScriptWorker::start() {
+    QString source = loadText("script/worker.py");
+    spawns().add();
+    // unbuffered, every response is flushed as soon as written
+    process.start("python", QStringList() << "-u" << "-c" << source);
     if (!co_await qCoro(process).waitForStarted()) {
-        qWarning() << "Failed to start script: " << process.errorString();
-        co_return ScriptResult::fail();
+        qWarning() << "Failed to start script worker: " << process.errorString();
+        co_return false;
+    }
+    co_return true;
+}
+
+bool ScriptWorker::isAlive() const { return process.state() == QProcess::Running; }
+
+void ScriptWorker::reply(const ScriptResult &result) {
+    timeout.stop();
+    if (!pending.has_value()) {
+        return;
     }
-    if (!co_await qCoro(process).waitForFinished()) {
-        qWarning() << "Script cost too long time: " << process.errorString();
+    pending->addResult(result);
+    pending->finish();
+    pending.reset();
+    pendingId = 0;
+}
+
+void ScriptWorker::readResponses() {
+    buffer += process.readAllStandardOutput();
+    qsizetype newline;
+    while ((newline = buffer.indexOf('\n')) >= 0) {
+        QByteArray line = buffer.left(newline);
+        buffer.remove(0, newline + 1);
+
+        WatchdogScope scope("ScriptWorker::readResponses");
+        QJsonObject response = QJsonDocument::fromJson(line).object();
+        if (static_cast<quint64>(response.value("id").toInteger()) != pendingId) {
+            qWarning() << "Script worker: unexpected response" << line.left(100);
+            continue;
+        }
+        reply(ScriptResult::ok(response.value("exitCode").toInt(),
+                               response.value("stdout").toString(),
+                               response.value("stderr").toString()));
+    }
+}
+
+QCoro::Task<ScriptResult> ScriptWorker::run(const QString &name, const QString &source,
+                                            const QStringList &args, const QByteArray &input) {
+    if (!isAlive() || pending.has_value()) {
         co_return ScriptResult::fail();
     }
+    pendingId = nextId++;
+    QJsonObject request{
+            {"id", static_cast<qint64>(pendingId)},
+            {"name", name},
+            {"source", source},
+            {"args", QJsonArray::fromStringList(args)},
+            {"stdin", QString::fromUtf8(input)},
+    };
+    pending.emplace();
+    pending->start();
+    auto future = pending->future();
+    {
+        WatchdogScope scope("ScriptWorker::run");
+        process.write(QJsonDocument(request).toJson(QJsonDocument::Compact) + '\n');
+    }
+    timeout.start();
+    co_return co_await future;
+}
+
+ScriptPool::ScriptPool() {
+    if (auto *app = QCoreApplication::instance()) {
+        moveToThread(app->thread());
+        // the workers are children of the pool, which outlives the event loop
+        connect(app, &QCoreApplication::aboutToQuit, this, [this] {
+            qDeleteAll(idle);
+            idle.clear();
+        });
+    }
+}
 
-    QString stdOut = process.readAllStandardOutput();
-    QString stdErr = process.readAllStandardError();
-    int exitCode = process.exitCode();
-    co_return ScriptResult::ok(exitCode, stdOut, stdErr);
+ScriptPool &ScriptPool::instance() {
+    static ScriptPool pool;
+    return pool;
+}
+
+QCoro::Task<ScriptResult> ScriptPool::run(const QString &name, const QString &source,
+                                          const QStringList &args, const QByteArray &input) {
+    ScriptWorker *worker = nullptr;
+    while (!idle.isEmpty() && !worker) {
+        worker = idle.takeLast();
+        if (!worker->isAlive()) {
+            worker->deleteLater();
+            worker = nullptr;
+        }
+    }
+    if (!worker) {
+        // as many workers as scripts run at once, which the task manager keeps to taskLimits.cpu
+        worker = new ScriptWorker(this);
+        if (!co_await worker->start()) {
+            worker->deleteLater();
+            co_return ScriptResult::fail();
+        }
+    }
+
+    auto result = co_await worker->run(name, source, args, input);
+    if (worker->isAlive()) {
+        idle.append(worker);
+    } else {
+        worker->deleteLater(); // the next script starts a new one
+    }
+    co_return result;
+}
+
+QCoro::Task<ScriptResult> runPythonScript(QFile &script, QStringList args, QByteArray input) {
+    TraceSpan span("script", "runPythonScript");
+    QString content;
+    {
+        WatchdogScope scope("runPythonScript");
+        if (!script.open(QIODevice::ReadOnly)) {
+            qWarning() << "Failed to read script: " << script.fileName();
+            co_return ScriptResult::fail();
+        }
+        QTextStream in(&script);
+        content = in.readAll();
+    }
+
+    // at most taskLimits.cpu scripts at once, the rest wait in the queue
+    QString name = QFileInfo(script.fileName()).fileName();
+    auto task = co_await TaskManager::instance().start(QObject::tr("运行 %1").arg(name),
+                                                       TaskResource::Cpu);
+    if (task.isCanceled()) {
+        co_return ScriptResult::fail();
+    }
+    co_return co_await ScriptPool::instance().run(name, content, args, input);
 }
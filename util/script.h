@@ -2,6 +2,11 @@
 #define SCRIPT_H
 
 #include <QFile>
+#include <QObject>
+#include <QProcess>
+#include <QPromise>
+#include <QTimer>
+#include <optional>
 #include <qcorotask.h>
 
 struct ScriptResult {
@@ -14,6 +19,49 @@ struct ScriptResult {
     static ScriptResult ok(int exitCode, const QString &stdOut, const QString &stdErr);
 };
 
-QCoro::Task<ScriptResult> runPythonScript(QFile &script, QStringList args);
+/**
+ * A python process kept running between the scripts, it runs one script at a time for the
+ * requests written to its stdin, see worker.py.
+ */
+class ScriptWorker : public QObject {
+    Q_OBJECT
+
+    QProcess process;
+    QByteArray buffer;
+    QTimer timeout;
+    quint64 nextId = 1;
+    quint64 pendingId = 0;
+    std::optional<QPromise<ScriptResult>> pending;
+
+    void readResponses();
+    void reply(const ScriptResult &result);
+
+public:
+    explicit ScriptWorker(QObject *parent = nullptr);
+    ~ScriptWorker() override;
+
+    QCoro::Task<bool> start();
+    bool isAlive() const;
+    QCoro::Task<ScriptResult> run(const QString &name, const QString &source,
+                                  const QStringList &args, const QByteArray &input);
+};
+
+/** The idle workers, a script takes one or starts a new one, and a crashed one is replaced */
+class ScriptPool : public QObject {
+    Q_OBJECT
+
+    QList<ScriptWorker *> idle;
+
+    ScriptPool();
+
+public:
+    static ScriptPool &instance();
+    QCoro::Task<ScriptResult> run(const QString &name, const QString &source,
+                                  const QStringList &args, const QByteArray &input);
+};
+
+/** Run the script with the args, and the UTF-8 input as its stdin */
+QCoro::Task<ScriptResult> runPythonScript(QFile &script, QStringList args,
+                                          QByteArray input = {});
 
 #endif // SCRIPT_H
@@ -0,0 +1,164 @@
+#include "task.h"
+
+#include <QJsonObject>
+#include <QMap>
+#include <algorithm>
+#include <limits>
+
+#include "file.h"
+
+TaskHandle::TaskHandle(std::shared_ptr<TaskState> state) : state(std::move(state)) {}
+
+TaskHandle::~TaskHandle() { finish(); }
+
+TaskHandle &TaskHandle::operator=(TaskHandle &&other) noexcept {
+    if (this != &other) {
+        finish();
+        state = std::move(other.state);
+    }
+    return *this;
+}
+
+void TaskHandle::update(int value, const QString &text) const {
+    if (!state) {
+        return;
+    }
+    state->info.value = value;
+    if (!text.isEmpty()) {
+        state->info.text = text;
+    }
+    emit TaskManager::instance().tasksChanged();
+}
+
+void TaskHandle::setText(const QString &text) const { update(state ? state->info.value : 0, text); }
+
+void TaskHandle::setMaximum(int max) const {
+    if (state) {
+        state->info.max = max;
+        emit TaskManager::instance().tasksChanged();
+    }
+}
+
+bool TaskHandle::isCanceled() const { return state && state->token.isCanceled(); }
+
+CancelToken TaskHandle::token() const { return state ? state->token : CancelToken(); }
+
+void TaskHandle::finish() {
+    if (state) {
+        TaskManager::instance().finish(state);
+        state.reset();
+    }
+}
+
+TaskManager &TaskManager::instance() {
+    static TaskManager manager;
+    return manager;
+}
+
+QString TaskManager::resourceName(TaskResource resource) {
+    switch (resource) {
+        case TaskResource::None:
+            return tr("界面");
+        case TaskResource::Network:
+            return tr("网络");
+        case TaskResource::Cpu:
+            return tr("计算");
+        case TaskResource::AI:
+            return tr("AI");
+    }
+    return {};
+}
+
+int TaskManager::limitOf(TaskResource resource) {
+    static const QMap<TaskResource, QString> keys = {
+            {TaskResource::Network, "network"},
+            {TaskResource::Cpu, "cpu"},
+            {TaskResource::AI, "ai"},
+    };
+    if (!keys.contains(resource)) {
+        return std::numeric_limits<int>::max(); // waiting on the user, not on a resource
+    }
+    auto limits = Configs::instance().get("taskLimits").toObject();
+    return std::max(1, limits.value(keys[resource]).toInt(1));
+}
+
+QCoro::Task<TaskHandle> TaskManager::start(const QString &title, TaskResource resource,
+                                           TaskPriority priority, int max) {
+    auto state = std::make_shared<TaskState>();
+    state->info.id = nextId++;
+    state->info.title = title;
+    state->info.max = max;
+    state->info.priority = priority;
+    state->info.resource = resource;
+    state->started.start();
+    auto started = state->started.future();
+    tasks.append(state);
+    dispatch();
+    emit tasksChanged();
+
+    if (!started.isFinished()) {
+        co_await started;
+    }
+    co_return TaskHandle(state);
+}
+
+void TaskManager::dispatch() {
+    QList<std::shared_ptr<TaskState>> queued;
+    for (const auto &task: tasks) {
+        if (!task->info.running) {
+            queued.append(task);
+        }
+    }
+    // the earlier created first among the same priority
+    std::stable_sort(queued.begin(), queued.end(), [](const auto &a, const auto &b) {
+        return a->info.priority > b->info.priority;
+    });
+    for (const auto &task: queued) {
+        auto index = static_cast<int>(task->info.resource);
+        if (running[index] < limitOf(task->info.resource)) {
+            running[index]++;
+            task->info.running = true;
+            task->started.finish();
+        }
+    }
+}
+
+void TaskManager::finish(const std::shared_ptr<TaskState> &state) {
+    if (state->finished) {
+        return;
+    }
+    state->finished = true;
+    if (state->info.running) {
+        running[static_cast<int>(state->info.resource)]--;
+    }
+    tasks.removeOne(state);
+    dispatch();
+    emit tasksChanged();
+}
+
+QList<TaskInfo> TaskManager::currentTasks() const {
+    QList<TaskInfo> result;
+    result.reserve(tasks.size());
+    for (const auto &task: tasks) {
+        result.append(task->info);
+    }
+    return result;
+}
+
+void TaskManager::cancel(quint64 id) {
+    for (const auto &task: tasks) {
+        if (task->info.id != id) {
+            continue;
+        }
+        task->token.cancel();
+        if (!task->info.running) {
+            // wake the waiting coroutine, it finds its task canceled
+            auto queued = task;
+            finish(queued);
+            queued->started.finish();
+        } else {
+            emit tasksChanged();
+        }
+        return;
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <QFuture>
+#include <QObject>
+#include <QPromise>
+#include <QString>
+#include <array>
+#include <memory>
+#include <qcorotask.h>
+
+#include "worker.h"
+
+enum class TaskPriority { Low, Normal, High };
+
+/** What a task holds while running, each resource limits how many tasks run at once */
+enum class TaskResource { None, Network, Cpu, AI };
+
+constexpr int TASK_RESOURCES = 4;
+
+/** A task as shown in the footer */
+struct TaskInfo {
+    quint64 id = 0;
+    QString title;
+    /** What the task is doing now, the title if empty */
+    QString text;
+    int value = 0;
+    /** 0 if the progress is unknown */
+    int max = 0;
+    TaskPriority priority = TaskPriority::Normal;
+    TaskResource resource = TaskResource::None;
+    bool running = false;
+};
+
+struct TaskState {
+    TaskInfo info;
+    CancelToken token;
+    QPromise<void> started;
+    bool finished = false;
+};
+
+/**
+ * Held by the coroutine doing the work of a task, the task ends when it is destroyed.
+ * Check isCanceled() between the steps, the task manager only asks.
+ */
+class TaskHandle {
+    std::shared_ptr<TaskState> state;
+
+public:
+    TaskHandle() = default;
+    explicit TaskHandle(std::shared_ptr<TaskState> state);
+    ~TaskHandle();
+    TaskHandle(TaskHandle &&other) noexcept = default;
+    TaskHandle &operator=(TaskHandle &&other) noexcept;
+    TaskHandle(const TaskHandle &) = delete;
+    TaskHandle &operator=(const TaskHandle &) = delete;
+
+    void update(int value, const QString &text = {}) const;
+    void setText(const QString &text) const;
+    void setMaximum(int max) const;
+    bool isCanceled() const;
+    CancelToken token() const;
+    /** Release the resource, the next queued task may start */
+    void finish();
+};
+
+/**
+ * Run the background tasks of the application, such as downloads, parses and AI requests.
+ * A task waits in the queue until its resource has room, the higher priority first,
+ * and every task shows in the footer until it finishes.
+ * Lives on the GUI thread.
+ */
+class TaskManager : public QObject {
+    Q_OBJECT
+
+    /** Queued and running tasks, in the order of creation */
+    QList<std::shared_ptr<TaskState>> tasks;
+    std::array<int, TASK_RESOURCES> running{};
+    quint64 nextId = 1;
+
+    TaskManager() = default;
+    static int limitOf(TaskResource resource);
+    /** Start the queued tasks that fit in their resources */
+    void dispatch();
+    void finish(const std::shared_ptr<TaskState> &state);
+
+    friend class TaskHandle;
+
+signals:
+    /** A task was added, updated or finished */
+    void tasksChanged();
+
+public:
+    static TaskManager &instance();
+    static QString resourceName(TaskResource resource);
+
+    /** Queue a task and wait until it may run, a task canceled while queued never runs */
+    QCoro::Task<TaskHandle> start(const QString &title, TaskResource resource = TaskResource::None,
+                                  TaskPriority priority = TaskPriority::Normal, int max = 0);
+    QList<TaskInfo> currentTasks() const;
+    void cancel(quint64 id);
+};
+
+#endif // TASK_H
@@ -0,0 +1,146 @@
+#include "trace.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThread>
+
+#include "file.h"
+
+// events kept per thread and recording, about 2.5 MB, later ones are dropped
+#define TRACE_BUFFER_EVENTS 65536
+
+static thread_local TraceBuffer *localBuffer = nullptr;
+
+Tracer::Tracer() {
+    // the first span may begin on a worker, but the config updates come to the GUI thread
+    if (auto *app = QCoreApplication::instance()) {
+        moveToThread(app->thread());
+    }
+    clock.start();
+    onSetEnabled(Configs::instance().get("tracing").toBool());
+    Configs::bindHotUpdateOn(this, "tracing", &Tracer::onSetEnabled);
+}
+
+Tracer &Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+void Tracer::onSetEnabled(const bool &enable) {
+    if (enable && !enabled.load(std::memory_order_relaxed)) {
+        session.fetch_add(1, std::memory_order_release);
+    }
+    enabled.store(enable, std::memory_order_relaxed);
+}
+
+bool Tracer::isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+TraceBuffer *Tracer::registerThread() {
+    auto buffer = std::make_unique<TraceBuffer>();
+    buffer->events.resize(TRACE_BUFFER_EVENTS);
+    QString name = QThread::currentThread()->objectName();
+    auto *app = QCoreApplication::instance();
+    if (app != nullptr && QThread::currentThread() == app->thread()) {
+        name = "GUI";
+    }
+
+    QMutexLocker locker(&mutex);
+    buffer->tid = static_cast<int>(buffers.size()) + 1;
+    buffer->threadName = name.isEmpty() ? QString("thread %1").arg(buffer->tid) : name;
+    // the buffers live as long as the tracer, so the events of finished threads are kept
+    localBuffer = buffers.emplace_back(std::move(buffer)).get();
+    return localBuffer;
+}
+
+static void record(TraceBuffer *buffer, int session, const TraceEvent &event) {
+    if (buffer->session.load(std::memory_order_relaxed) != session) {
+        // the exporter reads the head only after seeing the new session
+        buffer->head.store(0, std::memory_order_relaxed);
+        buffer->dropped.store(0, std::memory_order_relaxed);
+        buffer->session.store(session, std::memory_order_release);
+    }
+    int head = buffer->head.load(std::memory_order_relaxed);
+    if (head >= TRACE_BUFFER_EVENTS) {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buffer->events[head] = event;
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+quint64 Tracer::begin(const char *category, const char *name) {
+    if (!enabled.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+    auto *buffer = localBuffer ? localBuffer : registerThread();
+    quint64 id = nextId.fetch_add(1, std::memory_order_relaxed);
+    record(buffer, session.load(std::memory_order_acquire),
+           {category, name, 'b', clock.nsecsElapsed(), id});
+    return id;
+}
+
+void Tracer::end(const char *category, const char *name, quint64 id) {
+    // a span ends even if the recording stopped, so it is never left open
+    auto *buffer = localBuffer ? localBuffer : registerThread();
+    record(buffer, session.load(std::memory_order_acquire),
+           {category, name, 'e', clock.nsecsElapsed(), id});
+}
+
+bool Tracer::exportTo(const QString &path) {
+    QJsonArray events;
+    int current = session.load(std::memory_order_acquire);
+    int dropped = 0;
+    {
+        QMutexLocker locker(&mutex);
+        for (const auto &buffer: buffers) {
+            if (buffer->session.load(std::memory_order_acquire) != current) {
+                continue; // nothing recorded by this thread yet
+            }
+            events.append(QJsonObject{{"name", "thread_name"},
+                                      {"ph", "M"},
+                                      {"pid", 1},
+                                      {"tid", buffer->tid},
+                                      {"args", QJsonObject{{"name", buffer->threadName}}}});
+            int head = buffer->head.load(std::memory_order_acquire);
+            for (int i = 0; i < head; ++i) {
+                const auto &event = buffer->events[i];
+                events.append(QJsonObject{
+                        {"name", event.name},
+                        {"cat", event.category},
+                        {"ph", QString(QLatin1Char(event.phase))},
+                        {"id", QString("0x%1").arg(event.id, 0, 16)},
+                        {"ts", static_cast<double>(event.time) / 1000},
+                        {"pid", 1},
+                        {"tid", buffer->tid},
+                });
+            }
+            dropped += buffer->dropped.load(std::memory_order_relaxed);
+        }
+    }
+    if (dropped > 0) {
+        qWarning() << "Tracer:" << dropped << "events dropped, the buffers are full";
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Tracer: cannot write" << path << file.errorString();
+        return false;
+    }
+    QJsonObject trace{{"traceEvents", events},
+                      {"displayTimeUnit", "ms"},
+                      {"otherData", QJsonObject{{"droppedEvents", dropped}}}};
+    file.write(QJsonDocument(trace).toJson(QJsonDocument::Compact));
+    return true;
+}
+
+TraceSpan::TraceSpan(const char *category, const char *name) :
+    category(category), name(name), id(Tracer::instance().begin(category, name)) {}
+
+TraceSpan::~TraceSpan() {
+    if (id != 0) {
+        Tracer::instance().end(category, name, id);
+    }
+}
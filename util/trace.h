@@ -0,0 +1,83 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QObject>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/** One record of the Chrome trace event format, names are string literals */
+struct TraceEvent {
+    const char *category;
+    const char *name;
+    /** 'b' or 'e', the async begin and end of a span */
+    char phase;
+    /** Since the tracer started, in ns */
+    qint64 time;
+    quint64 id;
+};
+
+/** The events of one thread, only that thread writes, the exporter reads the published ones */
+struct TraceBuffer {
+    int tid;
+    QString threadName;
+    std::vector<TraceEvent> events;
+    /** The events before it are published */
+    std::atomic<int> head = 0;
+    /** The recording the events belong to, the writer resets the buffer for a new one */
+    std::atomic<int> session = 0;
+    std::atomic<int> dropped = 0;
+};
+
+/**
+ * Record spans of the coroutines and export them in the Chrome trace event format,
+ * which chrome://tracing and Perfetto open.
+ * Spans are async events paired by id, so they may cross co_await and interleave on a thread.
+ * Recording costs a relaxed load when disabled, and no lock when enabled.
+ */
+class Tracer : public QObject {
+    Q_OBJECT
+
+    QElapsedTimer clock;
+    std::atomic<bool> enabled = false;
+    std::atomic<int> session = 0;
+    std::atomic<quint64> nextId = 1;
+
+    /** Locked only when a thread records for the first time and when exporting */
+    QMutex mutex;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;
+
+    Tracer();
+    TraceBuffer *registerThread();
+
+public slots:
+    /** Enabling starts a new recording, the events of the last one are dropped */
+    void onSetEnabled(const bool &enable);
+
+public:
+    static Tracer &instance();
+
+    bool isEnabled() const;
+    /** The id of the new span, 0 if not recording */
+    quint64 begin(const char *category, const char *name);
+    void end(const char *category, const char *name, quint64 id);
+    /** Write the current recording as trace event JSON, return if succeeded */
+    bool exportTo(const QString &path);
+};
+
+/** An async span from the construction to the destruction, safe to keep across co_await */
+class TraceSpan {
+    const char *category;
+    const char *name;
+    quint64 id;
+
+public:
+    TraceSpan(const char *category, const char *name);
+    ~TraceSpan();
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+};
+
+#endif // TRACE_H
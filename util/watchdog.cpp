@@ -0,0 +1,162 @@
+#include "watchdog.h"
+
+#include <QApplication>
+#include <QDebug>
+
+#include "file.h"
+
+// how often the GUI thread beats (ms)
+#define HEARTBEAT_INTERVAL 20
+// the watchdog checks a few times per threshold, but never busy loops
+#define MIN_CHECK_INTERVAL 10
+
+Watchdog::Watchdog() : threshold(Configs::instance().get("stallThresholdMs").toInt()) {
+    Configs::bindHotUpdateOn(this, "stallThresholdMs", &Watchdog::onSetThreshold);
+    heartbeat.setInterval(HEARTBEAT_INTERVAL);
+    connect(&heartbeat, &QTimer::timeout, this,
+            [this] { lastBeat.store(clock.elapsed(), std::memory_order_relaxed); });
+}
+
+Watchdog::~Watchdog() { stop(); }
+
+Watchdog &Watchdog::instance() {
+    static Watchdog watchdog;
+    return watchdog;
+}
+
+void Watchdog::onSetThreshold(const int &ms) { threshold.store(ms, std::memory_order_relaxed); }
+
+void Watchdog::start() {
+    if (thread) {
+        return;
+    }
+    guiThread.store(QThread::currentThread());
+    clock.start();
+    lastBeat.store(0);
+    heartbeat.start();
+
+    running = true;
+    thread = QThread::create([this] { watch(); });
+    thread->setObjectName("watchdog");
+    thread->start();
+    // the thread must not outlive the application objects it reads
+    connect(qApp, &QCoreApplication::aboutToQuit, this, &Watchdog::stop);
+}
+
+void Watchdog::stop() {
+    if (!thread) {
+        return;
+    }
+    {
+        QMutexLocker locker(&stopMutex);
+        running = false;
+        stopping.wakeAll();
+    }
+    thread->wait();
+    delete thread;
+    thread = nullptr;
+    heartbeat.stop();
+}
+
+void Watchdog::watch() {
+    bool stalled = false;
+    qint64 stallBeat = 0;
+    Stall stall;
+
+    QMutexLocker locker(&stopMutex);
+    while (running) {
+        int limit = threshold.load(std::memory_order_relaxed);
+        stopping.wait(&stopMutex, std::max(limit / 4, MIN_CHECK_INTERVAL));
+        if (!running) {
+            break;
+        }
+        qint64 beat = lastBeat.load(std::memory_order_relaxed);
+        qint64 now = clock.elapsed();
+        if (!stalled) {
+            if (limit > 0 && now - beat > limit) {
+                stalled = true;
+                stallBeat = beat;
+                stall = {QDateTime::currentDateTime().addMSecs(beat - now), 0, currentTask()};
+            }
+        } else if (beat != stallBeat) {
+            // the loop is back, the stall lasted until this beat
+            stalled = false;
+            stall.duration = beat - stallBeat;
+            record(stall);
+        } else if (stall.task.isEmpty()) {
+            // the culprit may enter its marker late, such as after a slow allocation
+            stall.task = currentTask();
+        }
+    }
+}
+
+QString Watchdog::currentTask() const {
+    QStringList names;
+    int top = depth.load(std::memory_order_acquire);
+    for (int i = 0; i < top; ++i) {
+        if (const char *name = scopes[i].load(std::memory_order_acquire)) {
+            names.append(QString::fromLatin1(name));
+        }
+    }
+    return names.join(" > ");
+}
+
+void Watchdog::record(const Stall &stall) {
+    {
+        QMutexLocker locker(&stallMutex);
+        stalls[nextStall] = stall;
+        nextStall = (nextStall + 1) % MAX_STALLS;
+        stallCount = std::min(stallCount + 1, MAX_STALLS);
+    }
+    qWarning() << "Watchdog: GUI thread stalled for" << stall.duration << "ms in"
+               << (stall.task.isEmpty() ? "an unknown task" : stall.task);
+    emit stallRecorded(stall);
+}
+
+QList<Stall> Watchdog::recentStalls() {
+    QMutexLocker locker(&stallMutex);
+    QList<Stall> result;
+    result.reserve(stallCount);
+    int first = (nextStall - stallCount + MAX_STALLS) % MAX_STALLS;
+    for (int i = 0; i < stallCount; ++i) {
+        result.append(stalls[(first + i) % MAX_STALLS]);
+    }
+    return result;
+}
+
+void Watchdog::clearStalls() {
+    QMutexLocker locker(&stallMutex);
+    nextStall = 0;
+    stallCount = 0;
+}
+
+int Watchdog::enter(const char *name) {
+    // only the GUI thread pushes and pops, the watchdog thread only reads
+    if (QThread::currentThread() != guiThread.load(std::memory_order_relaxed)) {
+        return -1;
+    }
+    int top = depth.load(std::memory_order_relaxed);
+    if (top >= MAX_DEPTH) {
+        return -1;
+    }
+    scopes[top].store(name, std::memory_order_release);
+    depth.store(top + 1, std::memory_order_release);
+    return top;
+}
+
+void Watchdog::leave(int slot) {
+    if (slot < 0) {
+        return;
+    }
+    scopes[slot].store(nullptr, std::memory_order_release);
+    // a marker of a coroutine may leave before the ones entered after it
+    int top = depth.load(std::memory_order_relaxed);
+    while (top > 0 && !scopes[top - 1].load(std::memory_order_relaxed)) {
+        --top;
+    }
+    depth.store(top, std::memory_order_release);
+}
+
+WatchdogScope::WatchdogScope(const char *name) : slot(Watchdog::instance().enter(name)) {}
+
+WatchdogScope::~WatchdogScope() { Watchdog::instance().leave(slot); }
@@ -0,0 +1,97 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+#include <QWaitCondition>
+#include <array>
+#include <atomic>
+
+/** The GUI thread did not return to the event loop for a while */
+struct Stall {
+    QDateTime start;
+    /** In ms */
+    qint64 duration = 0;
+    /** The scopes running when the stall was noticed, outermost first, empty if unknown */
+    QString task;
+};
+
+/**
+ * Notice the stalls of the GUI event loop from another thread.
+ * A timer on the GUI thread beats, and the watchdog thread checks the time since the last beat.
+ * A stall longer than the threshold is blamed on the scope markers entered at that moment,
+ * and kept in a ring buffer the diagnostics read.
+ */
+class Watchdog : public QObject {
+    Q_OBJECT
+
+    static constexpr int MAX_DEPTH = 16;
+    static constexpr int MAX_STALLS = 64;
+
+    QElapsedTimer clock;
+    QTimer heartbeat;
+    QThread *thread = nullptr;
+    std::atomic<QThread *> guiThread = nullptr;
+    std::atomic<qint64> lastBeat = 0;
+    std::atomic<int> threshold;
+
+    /** The scope markers of the GUI thread, names are string literals */
+    std::array<std::atomic<const char *>, MAX_DEPTH> scopes{};
+    std::atomic<int> depth = 0;
+
+    QMutex stopMutex;
+    QWaitCondition stopping;
+    bool running = false;
+
+    QMutex stallMutex;
+    std::array<Stall, MAX_STALLS> stalls;
+    int nextStall = 0;
+    int stallCount = 0;
+
+    Watchdog();
+    void watch();
+    QString currentTask() const;
+    void record(const Stall &stall);
+
+signals:
+    /** Emitted from the watchdog thread */
+    void stallRecorded(const Stall &stall);
+
+public slots:
+    void onSetThreshold(const int &ms);
+
+public:
+    ~Watchdog() override;
+    static Watchdog &instance();
+
+    /** Start watching the thread it is called on, which must be the GUI thread */
+    void start();
+    void stop();
+    /** Oldest first */
+    QList<Stall> recentStalls();
+    void clearStalls();
+
+    /** The slot of the marker, -1 if the stack is full or not on the GUI thread */
+    int enter(const char *name);
+    void leave(int slot);
+};
+
+/**
+ * Mark the GUI thread as running a named task until the end of the scope.
+ * Never keep one across a co_await, the coroutine is not running while suspended.
+ */
+class WatchdogScope {
+    int slot;
+
+public:
+    explicit WatchdogScope(const char *name);
+    ~WatchdogScope();
+    WatchdogScope(const WatchdogScope &) = delete;
+    WatchdogScope &operator=(const WatchdogScope &) = delete;
+};
+
+#endif // WATCHDOG_H
@@ -0,0 +1,132 @@
+#include "worker.h"
+
+// the worker a job runs on, -1 on the other threads
+static thread_local int workerIndex = -1;
+
+WorkerPool::WorkerPool() {
+    // the GUI thread keeps a core for itself
+    int count = std::max(2, QThread::idealThreadCount() - 1);
+    for (int i = 0; i < count; ++i) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (int i = 0; i < count; ++i) {
+        auto *thread = QThread::create([this, i] { run(i); });
+        thread->setObjectName(QString("worker %1").arg(i + 1));
+        thread->start();
+        workers[i]->thread = thread;
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        QMutexLocker locker(&idleMutex);
+        stopping = true;
+        idle.wakeAll();
+    }
+    for (auto &worker: workers) {
+        worker->thread->wait();
+        delete worker->thread;
+    }
+}
+
+WorkerPool &WorkerPool::instance() {
+    static WorkerPool pool;
+    return pool;
+}
+
+void WorkerPool::post(Job job) {
+    // a job posted by a job stays on its worker until stolen
+    int index = workerIndex >= 0
+                        ? workerIndex
+                        : static_cast<int>(nextWorker.fetch_add(1, std::memory_order_relaxed) %
+                                           workers.size());
+    {
+        QMutexLocker locker(&workers[index]->mutex);
+        workers[index]->jobs.push_back(std::move(job));
+    }
+    QMutexLocker locker(&idleMutex);
+    ++queued;
+    idle.wakeOne();
+}
+
+bool WorkerPool::take(int index, Job &job) {
+    {
+        // the newest job of its own, its data is likely still in the cache
+        auto &own = *workers[index];
+        QMutexLocker locker(&own.mutex);
+        if (!own.jobs.empty()) {
+            job = std::move(own.jobs.back());
+            own.jobs.pop_back();
+            return true;
+        }
+    }
+    int count = static_cast<int>(workers.size());
+    for (int i = 1; i < count; ++i) {
+        // the oldest job of another one, it is the furthest from what that one works on
+        auto &other = *workers[(index + i) % count];
+        QMutexLocker locker(&other.mutex);
+        if (!other.jobs.empty()) {
+            job = std::move(other.jobs.front());
+            other.jobs.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkerPool::run(int index) {
+    workerIndex = index;
+    Job job;
+    while (true) {
+        if (take(index, job)) {
+            {
+                QMutexLocker locker(&idleMutex);
+                --queued;
+            }
+            job();
+            job = nullptr;
+            continue;
+        }
+        QMutexLocker locker(&idleMutex);
+        while (queued <= 0 && !stopping) {
+            idle.wait(&idleMutex);
+        }
+        if (queued <= 0 && stopping) {
+            return;
+        }
+    }
+}
+
+SerialQueue::~SerialQueue() {
+    QMutexLocker locker(&mutex);
+    while (draining) {
+        drained.wait(&mutex);
+    }
+}
+
+void SerialQueue::post(WorkerPool::Job job) {
+    QMutexLocker locker(&mutex);
+    jobs.push_back(std::move(job));
+    if (draining) {
+        return; // picked up by the running drain
+    }
+    draining = true;
+    WorkerPool::instance().post([this] { drain(); });
+}
+
+void SerialQueue::drain() {
+    while (true) {
+        WorkerPool::Job job;
+        {
+            QMutexLocker locker(&mutex);
+            if (jobs.empty()) {
+                draining = false;
+                drained.wakeAll();
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
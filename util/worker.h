@@ -0,0 +1,140 @@
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <QCoreApplication>
+#include <QFuture>
+#include <QMutex>
+#include <QPromise>
+#include <QThread>
+#include <QWaitCondition>
+#include <atomic>
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <qcorofuture.h>
+#include <qcorotask.h>
+#include <vector>
+
+/** Shared by the owner of some work and the work, the work checks it at its own pace */
+class CancelToken {
+    std::shared_ptr<std::atomic_bool> canceled = std::make_shared<std::atomic_bool>(false);
+
+public:
+    void cancel() const { canceled->store(true, std::memory_order_relaxed); }
+    bool isCanceled() const { return canceled->load(std::memory_order_relaxed); }
+};
+
+/**
+ * The threads for the CPU and disk work of the application, one less than the cores.
+ * Every worker has its own queue: it runs its newest job first, and steals the oldest job of
+ * another worker when it runs out, so jobs posted by a job stay close to it.
+ */
+class WorkerPool {
+public:
+    using Job = std::function<void()>;
+
+private:
+    struct Worker {
+        QMutex mutex;
+        std::deque<Job> jobs;
+        QThread *thread = nullptr;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<unsigned> nextWorker = 0;
+
+    QMutex idleMutex;
+    QWaitCondition idle;
+    /** Jobs posted and not taken yet, may be briefly negative */
+    int queued = 0;
+    bool stopping = false;
+
+    WorkerPool();
+    bool take(int index, Job &job);
+    void run(int index);
+
+public:
+    /** Runs the jobs left before returning */
+    ~WorkerPool();
+    static WorkerPool &instance();
+
+    void post(Job job);
+
+    /** Run fn on a worker and get its result on the thread awaiting, fn must return a value */
+    template<class F>
+    QCoro::Task<std::invoke_result_t<F>> run(F fn);
+};
+
+template<class F>
+QCoro::Task<std::invoke_result_t<F>> WorkerPool::run(F fn) {
+    auto promise = std::make_shared<QPromise<std::invoke_result_t<F>>>();
+    auto future = promise->future();
+    post([promise, fn = std::move(fn)] {
+        promise->start();
+        promise->addResult(fn());
+        promise->finish();
+    });
+    co_return co_await future;
+}
+
+/** Jobs run one after another in the order posted, on any worker */
+class SerialQueue {
+    QMutex mutex;
+    QWaitCondition drained;
+    std::deque<WorkerPool::Job> jobs;
+    bool draining = false;
+
+    void drain();
+
+public:
+    SerialQueue() = default;
+    /** Waits for the jobs left, the pool may outlive the queue */
+    ~SerialQueue();
+    SerialQueue(const SerialQueue &) = delete;
+    SerialQueue &operator=(const SerialQueue &) = delete;
+
+    void post(WorkerPool::Job job);
+};
+
+/**
+ * co_await resumeOnWorker() continues the coroutine on a worker.
+ * Nothing owned by the GUI thread may be touched there, and the coroutine must come back with
+ * resumeOnMain() before it ends, since its caller resumes on the thread it ends on.
+ */
+struct ResumeOnWorker {
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) const {
+        WorkerPool::instance().post([handle] { handle.resume(); });
+    }
+    void await_resume() const noexcept {}
+};
+
+/**
+ * co_await resumeOnMain(token) continues on the GUI thread, and is false if canceled by then.
+ * Once the application is gone the coroutine is destroyed instead of continued.
+ */
+struct ResumeOnMain {
+    CancelToken token;
+
+    bool await_ready() const noexcept {
+        auto *app = QCoreApplication::instance();
+        return app != nullptr && QThread::currentThread() == app->thread();
+    }
+    void await_suspend(std::coroutine_handle<> handle) const {
+        auto *app = QCoreApplication::instance();
+        if (app == nullptr) {
+            // the application has quit while a worker ran, there is no GUI thread to go back to
+            handle.destroy();
+            return;
+        }
+        QMetaObject::invokeMethod(app, [handle] { handle.resume(); }, Qt::QueuedConnection);
+    }
+    bool await_resume() const noexcept { return !token.isCanceled(); }
+};
+
+inline ResumeOnWorker resumeOnWorker() { return {}; }
+
+inline ResumeOnMain resumeOnMain(const CancelToken &token = {}) { return {token}; }
+
+#endif // WORKER_H
@@ -6,6 +6,7 @@
 #include <QNetworkRequest>
 
 #include "../util/file.h"
+#include "../util/task.h"
 
 // Initialize static instance pointer
 AIClient *AIClient::instance = nullptr;
@@ -60,7 +61,12 @@ AIClient::sendRequest(const QString &prompt, int maxTokens, double temperature)
     QJsonObject requestJson = buildRequestJson(prompt, maxTokens, temperature);
     QByteArray requestData = QJsonDocument(requestJson).toJson();
 
+    auto task = co_await TaskManager::instance().start(tr("AI 请求"), TaskResource::AI);
+    if (task.isCanceled()) {
+        co_return std::unexpected(tr("请求已取消"));
+    }
     QNetworkReply *reply = co_await nam.post(request, requestData);
+    task.finish();
 
     if (reply->error()) {
         QString errorMsg = reply->errorString();
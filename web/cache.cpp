@@ -0,0 +1,147 @@
+#include "cache.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <algorithm>
+
+#include "../util/file.h"
+#include "../util/watchdog.h"
+
+static QString hashName(const QByteArray &data) {
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
+}
+
+PageCache::PageCache() :
+    dir(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) +
+        "/never-judge/pages") {}
+
+PageCache &PageCache::instance() {
+    static PageCache cache;
+    return cache;
+}
+
+bool PageCache::isOffline() { return Configs::instance().get("offline").toBool(); }
+
+QByteArray PageCache::parseKey(const QString &script, const QByteArray &html) {
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(script.toUtf8());
+    hash.addData(html);
+    return hash.result().toHex();
+}
+
+void PageCache::scan() {
+    if (scanned) {
+        return;
+    }
+    scanned = true;
+    WatchdogScope scope("PageCache::scan");
+    QDir().mkpath(dir);
+    // the pages are fetched with the session of the user, like the cookies they are theirs only
+    QFile::setPermissions(dir, QFileDevice::ReadOwner | QFileDevice::WriteOwner |
+                                       QFileDevice::ExeOwner);
+    for (const auto &info: QDir(dir).entryInfoList(QDir::Files)) {
+        entries.insert(info.fileName(), {info.size(), info.lastModified()});
+        totalSize += info.size();
+    }
+}
+
+std::optional<QByteArray> PageCache::read(const QString &name) {
+    scan();
+    auto it = entries.find(name);
+    if (it == entries.end()) {
+        return std::nullopt;
+    }
+    WatchdogScope scope("PageCache::read");
+    QFile file(dir + "/" + name);
+    if (!file.open(QIODevice::ReadOnly)) {
+        totalSize -= it->size;
+        entries.erase(it);
+        return std::nullopt;
+    }
+    // the modification time keeps the order of use between runs
+    it->used = QDateTime::currentDateTime();
+    file.setFileTime(it->used, QFileDevice::FileModificationTime);
+    return file.readAll();
+}
+
+void PageCache::write(const QString &name, const QByteArray &data) {
+    scan();
+    WatchdogScope scope("PageCache::write");
+    QSaveFile file(dir + "/" + name);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        qWarning() << "PageCache: cannot write" << file.fileName() << file.errorString();
+        return;
+    }
+    if (auto it = entries.find(name); it != entries.end()) {
+        totalSize -= it->size;
+    }
+    entries.insert(name, {data.size(), QDateTime::currentDateTime()});
+    totalSize += data.size();
+    evict();
+}
+
+void PageCache::evict() {
+    qint64 limit = Configs::instance().get("cacheLimitMB").toInteger(64) * 1024 * 1024;
+    if (totalSize <= limit) {
+        return;
+    }
+    QList<QString> names = entries.keys();
+    std::sort(names.begin(), names.end(), [this](const QString &a, const QString &b) {
+        return entries[a].used < entries[b].used;
+    });
+    for (const auto &name: names) {
+        if (totalSize <= limit) {
+            break;
+        }
+        QFile::remove(dir + "/" + name);
+        totalSize -= entries.take(name).size;
+    }
+}
+
+std::optional<CachedPage> PageCache::page(const QUrl &url) {
+    auto data = read(hashName(url.toEncoded()) + ".page");
+    if (!data.has_value()) {
+        return std::nullopt;
+    }
+    // a line of metadata before the body
+    auto split = data->indexOf('\n');
+    auto meta = QJsonDocument::fromJson(data->left(split)).object();
+    return CachedPage{data->mid(split + 1), meta.value("etag").toString().toLatin1(),
+                      meta.value("lastModified").toString().toLatin1()};
+}
+
+void PageCache::storePage(const QUrl &url, const CachedPage &page) {
+    QJsonObject meta{
+            {"url", url.toString()},
+            {"etag", QString::fromLatin1(page.etag)},
+            {"lastModified", QString::fromLatin1(page.lastModified)},
+    };
+    write(hashName(url.toEncoded()) + ".page",
+          QJsonDocument(meta).toJson(QJsonDocument::Compact) + '\n' + page.body);
+}
+
+std::optional<QString> PageCache::parsed(const QByteArray &key) {
+    auto data = read(key + ".parsed");
+    if (!data.has_value()) {
+        return std::nullopt;
+    }
+    return QString::fromUtf8(data.value());
+}
+
+void PageCache::storeParsed(const QByteArray &key, const QString &output) {
+    write(key + ".parsed", output.toUtf8());
+}
+
+void PageCache::clear() {
+    scan();
+    for (auto it = entries.cbegin(); it != entries.cend(); ++it) {
+        QFile::remove(dir + "/" + it.key());
+    }
+    entries.clear();
+    totalSize = 0;
+}
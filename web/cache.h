@@ -0,0 +1,56 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QHash>
+#include <QString>
+#include <QUrl>
+#include <optional>
+
+/** A page as fetched, with what the server needs to tell whether it changed */
+struct CachedPage {
+    QByteArray body;
+    QByteArray etag;
+    QByteArray lastModified;
+};
+
+/**
+ * The pages fetched from OJ and the output of the parsers, on disk.
+ * A page is stored under the hash of its url, a parse under the hash of the script and the page,
+ * so a page that did not change is never parsed twice.
+ * The least recently used entries are dropped beyond cacheLimitMB. Used from the GUI thread.
+ */
+class PageCache {
+    struct Entry {
+        qint64 size;
+        QDateTime used;
+    };
+
+    QString dir;
+    /** By file name, filled from the directory on first use */
+    QHash<QString, Entry> entries;
+    qint64 totalSize = 0;
+    bool scanned = false;
+
+    PageCache();
+    void scan();
+    std::optional<QByteArray> read(const QString &name);
+    void write(const QString &name, const QByteArray &data);
+    /** Drop the least recently used entries until the cache fits in its limit */
+    void evict();
+
+public:
+    static PageCache &instance();
+    /** Whether the pages are served from the cache only, see the "offline" config */
+    static bool isOffline();
+    static QByteArray parseKey(const QString &script, const QByteArray &html);
+
+    std::optional<CachedPage> page(const QUrl &url);
+    void storePage(const QUrl &url, const CachedPage &page);
+    std::optional<QString> parsed(const QByteArray &key);
+    void storeParsed(const QByteArray &key, const QString &output);
+    void clear();
+};
+
+#endif // CACHE_H
@@ -0,0 +1,92 @@
+#include "cookies.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QNetworkCookie>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+// a page sets a few cookies at once, they are written together
+#define SAVE_DELAY 1000 // ms
+
+CookieJar::CookieJar(QObject *parent) : QNetworkCookieJar(parent) {
+    saveTimer.setSingleShot(true);
+    saveTimer.setInterval(SAVE_DELAY);
+    connect(&saveTimer, &QTimer::timeout, this, &CookieJar::save);
+    if (auto *app = QCoreApplication::instance()) {
+        connect(app, &QCoreApplication::aboutToQuit, this, [this] {
+            if (saveTimer.isActive()) {
+                saveTimer.stop();
+                save();
+            }
+        });
+    }
+    load();
+}
+
+QString CookieJar::path() {
+    return QStandardPaths::writableLocation(QStandardPaths::ConfigLocation) +
+           "/never-judge/cookies";
+}
+
+void CookieJar::load() {
+    QFile file(path());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return; // never logged in, or logged out
+    }
+    QList<QNetworkCookie> cookies;
+    auto now = QDateTime::currentDateTime();
+    while (!file.atEnd()) {
+        for (const auto &cookie: QNetworkCookie::parseCookies(file.readLine().trimmed())) {
+            // the session cookies are kept, the server decides whether they still work
+            if (cookie.isSessionCookie() || cookie.expirationDate() > now) {
+                cookies.append(cookie);
+            }
+        }
+    }
+    setAllCookies(cookies);
+    persistent = !cookies.isEmpty();
+}
+
+void CookieJar::save() const {
+    if (!persistent) {
+        return;
+    }
+    QDir().mkpath(QFileInfo(path()).absolutePath());
+    QSaveFile file(path());
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "CookieJar: cannot write" << path() << file.errorString();
+        return;
+    }
+    // on the temporary file before the session is in it, the file keeps them when committed
+    file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+    for (const auto &cookie: allCookies()) {
+        file.write(cookie.toRawForm(QNetworkCookie::Full) + '\n');
+    }
+    if (!file.commit()) {
+        qWarning() << "CookieJar: cannot write" << path() << file.errorString();
+    }
+}
+
+bool CookieJar::isPersistent() const { return persistent; }
+
+void CookieJar::setPersistent(bool persistent) {
+    this->persistent = persistent;
+    if (persistent) {
+        saveTimer.start();
+        return;
+    }
+    saveTimer.stop();
+    setAllCookies({});
+    QFile::remove(path());
+}
+
+bool CookieJar::setCookiesFromUrl(const QList<QNetworkCookie> &cookieList, const QUrl &url) {
+    bool changed = QNetworkCookieJar::setCookiesFromUrl(cookieList, url);
+    if (changed && persistent) {
+        saveTimer.start();
+    }
+    return changed;
+}
@@ -0,0 +1,32 @@
+#ifndef COOKIES_H
+#define COOKIES_H
+
+#include <QNetworkCookieJar>
+#include <QTimer>
+
+/**
+ * The cookies of the OJ session, kept on disk between runs once logged in.
+ * The file is only readable by its owner, it holds the session as good as a password.
+ */
+class CookieJar : public QNetworkCookieJar {
+    Q_OBJECT
+
+    QTimer saveTimer;
+    bool persistent = false;
+
+    static QString path();
+    void load();
+    void save() const;
+
+public:
+    explicit CookieJar(QObject *parent = nullptr);
+
+    /** Whether the cookies are saved, which is when they came from a login */
+    bool isPersistent() const;
+    /** Start saving the cookies, or drop them and their file */
+    void setPersistent(bool persistent);
+
+    bool setCookiesFromUrl(const QList<QNetworkCookie> &cookieList, const QUrl &url) override;
+};
+
+#endif // COOKIES_H
@@ -4,146 +4,284 @@
 #include <QJsonObject>
 #include <QJsonParseError>
 #include <QNetworkCookieJar>
-#include <QUrlQuery>
+#include <QNetworkReply>
+#include <QRegularExpression>
+#include <QStringDecoder>
+#include <qcorotimer.h>
 
+#include "../util/metrics.h"
+#include "../util/trace.h"
+#include "../util/watchdog.h"
+#include "cache.h"
+#include "limiter.h"
 
-#include "../util/file.h"
-#include "../util/script.h"
+// a page that stalls this long fails instead of hanging its task
+#define TRANSFER_TIMEOUT 10000 // ms
+#define LOGIN_URL "http://openjudge.cn/api/auth/login/"
 
-Crawler::Crawler() { nam.setCookieJar(new QNetworkCookieJar()); };
+Crawler::Crawler() {
+    // the session of the last run, if it logged in
+    jar = new CookieJar(&nam);
+    nam.setCookieJar(jar);
+    // the first request skips the TCP handshake
+    nam.connectToHost("openjudge.cn", 80);
+}
 
 Crawler &Crawler::instance() {
     static Crawler instance;
     return instance;
 }
 
-bool Crawler::hasLogin() const { return !email.isEmpty() && !password.isEmpty(); }
-
-// Crawler::WebResponse<QByteArray> Crawler::get(const QUrl &url) {
-//     QNetworkRequest request(url);
-//     request.setRawHeader("User-Agent", "Mozilla/5.0");
-//     request.setRawHeader("Referer", "http://cxsjsx.openjudge.cn/");
-//
-//     request.setTransferTimeout(5000);
-//     QNetworkReply *reply = co_await nam.get(request);
-//     if (reply->error()) {
-//         QString error = reply->errorString();
-//         delete reply;
-//         co_return std::unexpected(error);
-//     }
-//     if (reply->bytesAvailable() == 0) {
-//         delete reply;
-//         co_return std::unexpected("No data received");
-//     }
-//     QByteArray response = reply->readAll();
-//     delete reply;
-//     co_return response;
-// }
-//
-// Crawler::WebResponse<QByteArray> Crawler::post(const QUrl &url, QMap<QString, QString> params) {
-//     QNetworkRequest request(url);
-//     request.setTransferTimeout(5000);
-//     request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
-//     request.setRawHeader("User-Agent", "Mozilla/5.0");
-//     request.setRawHeader("Referer", "http://cxsjsx.openjudge.cn/");
-//
-//     QUrlQuery postParams;
-//     for (auto it = params.begin(); it != params.end(); ++it) {
-//         postParams.addQueryItem(it.key(), it.value());
-//     }
-//     QByteArray postData = postParams.toString(QUrl::FullyEncoded).toUtf8();
-//
-//     QNetworkReply *reply = co_await nam.post(request, postData);
-//     if (reply->error()) {
-//         QString error = reply->errorString();
-//         delete reply;
-//         co_return std::unexpected(error);
-//     }
-//     if (reply->bytesAvailable() == 0) {
-//         delete reply;
-//         co_return std::unexpected("No data received");
-//     }
-//     QByteArray response = reply->readAll();
-//     delete reply;
-//     co_return response;
-// }
-//
-// Crawler::WebResponse<QByteArray> Crawler::loginToOJ(const QString &email, const QString
-// &password) {
-//     QString loginUrl = "http://openjudge.cn/api/auth/login/";
-//     QMap<QString, QString> params = {{"email", email}, {"password", password}};
-//     auto res = co_await Crawler::instance().post(loginUrl, params);
-//     if (!res.has_value()) {
-//         co_return std::unexpected(res.error());
-//     }
-//
-//     QTextCodec *codec = QTextCodec::codecForName("GBK");
-//     QString response = codec->toUnicode(res.value());
-//     // use a json doc to parse the response
-//     QJsonParseError error;
-//     QJsonDocument doc = QJsonDocument::fromJson(response.toUtf8(), &error);
-//     if (error.error != QJsonParseError::NoError) {
-//         co_return std::unexpected("JSON parse error: " + error.errorString());
-//     }
-//     QJsonObject obj = doc.object();
-//     if (obj["result"].toString() == "SUCCESS") {
-//         co_return res;
-//     }
-//     QString message = obj["message"].toString();
-//     co_return std::unexpected(message);
-// }
-
-
-/* TODO: I know this implement is foolish
- * So fix the network manager later */
-
-Crawler::WebResponse<QByteArray> Crawler::get(const QUrl &url) const {
-    QStringList args = {"-u", url.toString()};
-
-    if (hasLogin()) {
-        args << "-e" << email << "-p" << password;
-    }
-
-    QFile crawl = loadRes("script/crawl.py");
-    auto res = co_await runPythonScript(crawl, args);
-    if (!res.success || res.exitCode != 0) {
-        co_return std::unexpected(res.stdErr);
-    }
-    co_return res.stdOut.toUtf8();
-}
-
-
-Crawler::WebResponse<QByteArray> Crawler::post(const QUrl &url, QMap<QString, QString> params) const {
-
-    QStringList args = {"-u", url.toString(), "-m", "post"};
-
-    QString paramsList = "{";
+bool Crawler::hasLogin() const {
+    return (!email.isEmpty() && !password.isEmpty()) || jar->isPersistent();
+}
+
+static Counter &fetchedBytes() {
+    static auto &counter = Metrics::instance().counter("neverjudge_crawler_fetched_bytes_total",
+                                                       "Bytes of the pages fetched from OJ.");
+    return counter;
+}
+
+static QNetworkRequest makeRequest(const QUrl &url) {
+    QNetworkRequest request(url);
+    request.setRawHeader("User-Agent", "Mozilla/5.0");
+    request.setRawHeader("Referer", "http://openjudge.cn/");
+    // Qt adds Accept-Encoding: gzip and inflates the body itself
+    request.setTransferTimeout(TRANSFER_TIMEOUT);
+    return request;
+}
+
+/** The charset of the page from its header or its meta tag, OJ serves GBK pages */
+static QByteArray charsetOf(const QNetworkReply *reply, const QByteArray &body) {
+    static const QRegularExpression charsetRegex(R"(charset\s*=\s*["']?([\w-]+))",
+                                                 QRegularExpression::CaseInsensitiveOption);
+    auto match = charsetRegex.match(reply->header(QNetworkRequest::ContentTypeHeader).toString());
+    if (!match.hasMatch()) {
+        match = charsetRegex.match(QString::fromLatin1(body.left(1024)));
+    }
+    return match.hasMatch() ? match.captured(1).toLatin1().toLower() : "utf-8";
+}
+
+/** The body of a finished reply as UTF-8, the parsers read nothing else */
+static std::expected<QByteArray, QString> readReply(QNetworkReply *reply) {
+    if (reply->error() != QNetworkReply::NoError) {
+        return std::unexpected(reply->errorString());
+    }
+    int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (status != 200) {
+        return std::unexpected(QObject::tr("请求失败，状态码：%1").arg(status));
+    }
+    WatchdogScope scope("Crawler::readResponse");
+    QByteArray body = reply->readAll();
+    fetchedBytes().add(body.size());
+
+    auto charset = charsetOf(reply, body);
+    if (charset == "utf-8" || charset == "utf8") {
+        return body;
+    }
+    // GB18030 decodes GBK and GB2312 as well
+    QStringDecoder decoder(charset == "gbk" || charset == "gb2312" ? "GB18030" : charset.data());
+    if (!decoder.isValid()) {
+        qWarning() << "Crawler: unknown charset" << charset << "of" << reply->url();
+        return body;
+    }
+    return QString(decoder(body)).toUtf8();
+}
+
+/** Whether OJ sent the request to its login page, which is what it does once a session expires */
+static bool isLoginPage(const QNetworkReply *reply) {
+    return reply->url().path().startsWith("/auth/login");
+}
+
+/** The form as application/x-www-form-urlencoded */
+static QByteArray encodeForm(const QMap<QString, QString> &params) {
+    // encoded by hand, QUrlQuery leaves '+' as is and the base64 source is full of them
+    QByteArray data;
     for (auto it = params.begin(); it != params.end(); ++it) {
-        paramsList += "'" + it.key() + "': '" + it.value() + "', ";
+        if (!data.isEmpty()) {
+            data += '&';
+        }
+        data += QUrl::toPercentEncoding(it.key()) + '=' + QUrl::toPercentEncoding(it.value());
+    }
+    return data;
+}
+
+QCoro::Task<QNetworkReply *> Crawler::send(QNetworkRequest request,
+                                           std::optional<QByteArray> body) {
+    auto &limiter = RateLimiter::instance();
+    co_await limiter.acquire(request.url());
+    QNetworkReply *reply = body.has_value() ? co_await nam.post(request, body.value())
+                                            : co_await nam.get(request);
+    limiter.feedback(reply);
+    co_return reply;
+}
+
+QCoro::Task<QNetworkReply *> Crawler::exchange(QNetworkRequest request,
+                                               std::optional<QByteArray> body) {
+    QNetworkReply *reply = co_await send(request, body);
+    if (isLoginPage(reply) && hasLogin()) {
+        // a restored session is only checked here, on the first page that needs it
+        reply->deleteLater();
+        if (!co_await refreshSession()) {
+            co_return nullptr;
+        }
+        reply = co_await send(request, body);
     }
-    paramsList += "}";
-    args << "-a" << paramsList;
+    co_return reply;
+}
 
-    if (hasLogin()) {
-        args << "-e" << email << "-p" << password;
+Crawler::WebResponse<QByteArray> Crawler::get(const QUrl &url, TaskPriority priority,
+                                              bool cacheable) {
+    TraceSpan span("crawler", "Crawler::get");
+    auto &cache = PageCache::instance();
+    auto cached = cacheable ? cache.page(url) : std::nullopt;
+    if (PageCache::isOffline()) {
+        if (cached.has_value()) {
+            co_return cached->body;
+        }
+        co_return std::unexpected(cacheable ? QObject::tr("离线模式下没有该页面的缓存")
+                                            : QObject::tr("离线模式下无法获取该页面"));
     }
 
-    QFile crawl = loadRes("script/crawl.py");
-    auto res = co_await runPythonScript(crawl, args);
-    if (!res.success || res.exitCode != 0) {
-        co_return std::unexpected(res.stdErr);
+    QString title = QObject::tr("请求 %1").arg(url.toString());
+    auto task = co_await TaskManager::instance().start(title, TaskResource::Network, priority);
+    if (task.isCanceled()) {
+        co_return std::unexpected(QObject::tr("请求已取消"));
     }
-    co_return res.stdOut.toUtf8();
+    QNetworkRequest request = makeRequest(url);
+    if (cached.has_value()) {
+        // the server answers 304 without the page if it did not change
+        if (!cached->etag.isEmpty()) {
+            request.setRawHeader("If-None-Match", cached->etag);
+        }
+        if (!cached->lastModified.isEmpty()) {
+            request.setRawHeader("If-Modified-Since", cached->lastModified);
+        }
+    }
+    QNetworkReply *reply;
+    for (int attempt = 0;; attempt++) {
+        reply = co_await exchange(request, std::nullopt);
+        if (!reply) {
+            co_return std::unexpected(QObject::tr("登录已过期，请重新登录"));
+        }
+        // a GET is safe to send again, post never retries so a submission is never sent twice
+        auto delay = RateLimiter::retryDelay(reply, attempt);
+        if (!delay.has_value()) {
+            break;
+        }
+        qWarning() << "Crawler: retrying" << url << "in" << delay->count() << "ms after"
+                   << reply->errorString();
+        reply->deleteLater();
+        // the slot is left to the other requests while backing off, the retry queues again
+        task.finish();
+        co_await QCoro::sleepFor(delay.value());
+        task = co_await TaskManager::instance().start(title, TaskResource::Network, priority);
+        if (task.isCanceled()) {
+            co_return std::unexpected(QObject::tr("请求已取消"));
+        }
+    }
+
+    std::expected<QByteArray, QString> response;
+    int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (cached.has_value() && status == 304) {
+        response = cached->body;
+    } else if (cached.has_value() && reply->error() != QNetworkReply::NoError &&
+               reply->error() < QNetworkReply::ContentAccessDenied) {
+        // the network failed rather than the server, the last copy beats nothing
+        qWarning() << "Crawler: serving the cached" << url << "after" << reply->errorString();
+        response = cached->body;
+    } else {
+        response = readReply(reply);
+        if (cacheable && response.has_value()) {
+            cache.storePage(url, {response.value(), reply->rawHeader("ETag"),
+                                  reply->rawHeader("Last-Modified")});
+        }
+    }
+    reply->deleteLater();
+    co_return response;
+}
+
+Crawler::WebResponse<QByteArray> Crawler::post(const QUrl &url, QMap<QString, QString> params,
+                                               TaskPriority priority) {
+    TraceSpan span("crawler", "Crawler::post");
+    auto task = co_await TaskManager::instance().start(QObject::tr("提交 %1").arg(url.toString()),
+                                                       TaskResource::Network, priority);
+    if (task.isCanceled()) {
+        co_return std::unexpected(QObject::tr("请求已取消"));
+    }
+    if (PageCache::isOffline()) {
+        co_return std::unexpected(QObject::tr("离线模式下无法提交"));
+    }
+    QNetworkRequest request = makeRequest(url);
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
+    QNetworkReply *reply = co_await exchange(request, encodeForm(params));
+    if (!reply) {
+        co_return std::unexpected(QObject::tr("登录已过期，请重新登录"));
+    }
+    auto response = readReply(reply);
+    reply->deleteLater();
+    co_return response;
+}
+
+Crawler::WebResponse<QByteArray> Crawler::authenticate(const QString &email,
+                                                       const QString &password) {
+    QNetworkRequest request = makeRequest(QUrl(LOGIN_URL));
+    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
+    auto form = encodeForm({{"email", email}, {"password", password}});
+    QNetworkReply *reply = co_await send(request, form);
+    auto response = readReply(reply);
+    reply->deleteLater();
+    if (!response.has_value()) {
+        co_return std::unexpected(response.error());
+    }
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(response.value(), &error);
+    if (error.error != QJsonParseError::NoError) {
+        co_return std::unexpected("JSON parse error: " + error.errorString());
+    }
+    QJsonObject obj = doc.object();
+    if (obj.value("result").toString() != "SUCCESS") {
+        co_return std::unexpected(obj.value("message").toString());
+    }
+    // the session cookie is in the jar now, it is saved for the next run from here on
+    jar->setPersistent(true);
+    co_return response.value();
+}
+
+QCoro::Task<bool> Crawler::refreshSession() {
+    if (email.isEmpty() || password.isEmpty()) {
+        // restored from the last run, the password was never known
+        jar->setPersistent(false);
+        co_return false;
+    }
+    auto response = co_await authenticate(email, password);
+    if (!response.has_value()) {
+        qWarning() << "Crawler: cannot log in again:" << response.error();
+        co_return false;
+    }
+    co_return true;
 }
 
 Crawler::WebResponse<QByteArray> Crawler::login(const QString &email, const QString &password) {
-    this->email = email;
-    this->password = password;
-    // go to the homepage for a test
-    return get(QUrl("http://openjudge.cn/"));
+    TraceSpan span("crawler", "Crawler::login");
+    if (PageCache::isOffline()) {
+        co_return std::unexpected(QObject::tr("离线模式下无法登录"));
+    }
+    auto task = co_await TaskManager::instance().start(QObject::tr("登录"), TaskResource::Network,
+                                                       TaskPriority::High);
+    if (task.isCanceled()) {
+        co_return std::unexpected(QObject::tr("请求已取消"));
+    }
+    auto response = co_await authenticate(email, password);
+    if (response.has_value()) {
+        this->email = email;
+        this->password = password;
+    }
+    co_return response;
 }
 
 Crawler::WebResponse<QUrl> Crawler::submit(OJSubmitForm form) {
+    TraceSpan span("crawler", "Crawler::submit");
     QUrl url = form.problemUrl.resolved(QUrl("/api/solution/submitv2/"));
     QByteArray encodedCode = form.code.toUtf8().toBase64();
     QMap<QString, QString> params = {
@@ -154,11 +292,12 @@ Crawler::WebResponse<QUrl> Crawler::submit(OJSubmitForm form) {
             {"source", QString::fromUtf8(encodedCode)},
     };
 
-    auto response = co_await post(url, params);
+    auto response = co_await post(url, params, TaskPriority::High);
     // read the response as a json object
     if (!response.has_value()) {
         co_return std::unexpected(response.error());
     }
+    WatchdogScope scope("Crawler::submit");
     QJsonParseError error;
     QJsonDocument doc = QJsonDocument::fromJson(response.value(), &error);
     if (error.error != QJsonParseError::NoError) {
@@ -173,6 +312,7 @@ Crawler::WebResponse<QUrl> Crawler::submit(OJSubmitForm form) {
 }
 
 Crawler::WebResponse<QByteArray> Crawler::personalize(OJPersonalizationForm form) {
+    TraceSpan span("crawler", "Crawler::personalize");
     QUrl url("http://openjudge.cn/api/user/modify-profile/");
     QMap<QString, QString> params{
             {"name", form.nickname},
@@ -187,6 +327,7 @@ Crawler::WebResponse<QByteArray> Crawler::personalize(OJPersonalizationForm form
     if (!response.has_value()) {
         co_return std::unexpected(response.error());
     }
+    WatchdogScope scope("Crawler::personalize");
     QJsonParseError jpError;
     QJsonDocument doc = QJsonDocument::fromJson(response.value(), &jpError);
     if (jpError.error != QJsonParseError::NoError) {
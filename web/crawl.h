@@ -2,30 +2,52 @@
 #define CRAWL_H
 
 #include <expected>
+#include <optional>
 #include <qcoro/qcoronetworkreply.h>
 #include <qcorotask.h>
 
+#include "../util/task.h"
+#include "cookies.h"
 #include "oj.h"
 
+/** The HTTP session with OJ, one connection and one cookie jar for the whole application */
 class Crawler {
+public:
+    // Basic wrapper for web request
+    // Returns the response or an error message
+    template<class T>
+    using WebResponse = QCoro::Task<std::expected<T, QString>>;
+
+private:
     QNetworkAccessManager nam;
+    CookieJar *jar;
 
     QString email;
     QString password;
 
     explicit Crawler();
 
+    QCoro::Task<QNetworkReply *> send(QNetworkRequest request, std::optional<QByteArray> body);
+    /**
+     * Send the request, and again after logging in if the session turned out expired.
+     * The reply is the caller's to delete, nullptr if the session could not be refreshed.
+     */
+    QCoro::Task<QNetworkReply *> exchange(QNetworkRequest request, std::optional<QByteArray> body);
+    WebResponse<QByteArray> authenticate(const QString &email, const QString &password);
+    /** Log in again with the password of this run, or forget the session without one */
+    QCoro::Task<bool> refreshSession();
+
 public:
     static Crawler &instance();
     bool hasLogin() const;
 
-    // Basic wrapper for web request
-    // Returns the response or an error message
-    template<class T>
-    using WebResponse = QCoro::Task<std::expected<T, QString>>;
-
-    WebResponse<QByteArray> get(const QUrl &url) const;
-    WebResponse<QByteArray> post(const QUrl &url, QMap<QString, QString> params) const;
+    // Both wait for a network slot of the task manager, the higher priority first.
+    // A cacheable get goes through the page cache, and only to it in the offline mode. Only the
+    // pages the same for every account are cacheable, the cache knows nothing of the session
+    WebResponse<QByteArray> get(const QUrl &url, TaskPriority priority = TaskPriority::Normal,
+                                bool cacheable = false);
+    WebResponse<QByteArray> post(const QUrl &url, QMap<QString, QString> params,
+                                 TaskPriority priority = TaskPriority::Normal);
 
     /** if login succeeded, return the response from OJ */
     WebResponse<QByteArray> login(const QString &email, const QString &password);
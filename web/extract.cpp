@@ -0,0 +1,158 @@
+#include "extract.h"
+
+#include <QMap>
+#include <QRegularExpression>
+
+std::expected<OJProblem, QString> OJExtractor::problem(const HtmlDocument &page) {
+    int title = page.find(page.find(HtmlDocument::ROOT, "div", "id", "pageTitle"), "h2");
+    if (title < 0) {
+        return std::unexpected("No title found in the file");
+    }
+    int content = page.find(HtmlDocument::ROOT, "dl", "class", "problem-content");
+    if (content < 0) {
+        return std::unexpected("No problem content found in the file");
+    }
+    static const QString css = "<style>\n"
+                               "dt { font-size: 20px; font-weight: bold; margin: 5px; }\n"
+                               "pre { background-color: #222222;}\n"
+                               "</style>\n";
+    static const QRegularExpression style(R"(style="[^"]*")");
+    QString html = page.outerHtml(content).remove(style);
+    return OJProblem(page.text(title).trimmed(), css + html);
+}
+
+std::expected<OJMatch, QString> OJExtractor::match(const HtmlDocument &page) {
+    int table = page.find(HtmlDocument::ROOT, "table");
+    if (table < 0) {
+        return std::unexpected("No problem table found in the file");
+    }
+    QList<QUrl> urls;
+    for (int title: page.findAll(page.find(table, "tbody"), "td", "class", "title")) {
+        int link = page.find(title, "a");
+        if (link >= 0) {
+            urls.append(QUrl(page.attr(link, "href")));
+        }
+    }
+    if (urls.isEmpty()) {
+        return std::unexpected("No problem found in the table");
+    }
+    return OJMatch(urls);
+}
+
+std::expected<OJSubmitForm, QString> OJExtractor::submitForm(const HtmlDocument &page) {
+    int contest = page.find(HtmlDocument::ROOT, "input", "name", "contestId");
+    int problem = page.find(HtmlDocument::ROOT, "input", "name", "problemNumber");
+    if (contest < 0 || problem < 0) {
+        return std::unexpected("No submit form found in the file");
+    }
+    QList<OJLanguage> languages;
+    for (int language: page.findAll(HtmlDocument::ROOT, "input", "name", "language")) {
+        // the name of the language is the text right after its radio button
+        int label = page.nextSibling(language);
+        QString value = page.attr(language, "value");
+        QString name = label >= 0 ? page.text(label).trimmed() : "";
+        languages.emplace_back(value, name.isEmpty() ? value : name);
+    }
+    if (languages.isEmpty()) {
+        return std::unexpected("No language found in the submit form");
+    }
+    return OJSubmitForm(page.attr(contest, "value"), page.attr(problem, "value"), languages);
+}
+
+OJSubmitResponse::Result OJExtractor::resultOf(const QString &status) {
+    static QMap<QString, OJSubmitResponse::Result> map = {
+            {"Waiting", OJSubmitResponse::W},
+            {"Accepted", OJSubmitResponse::AC},
+            {"Wrong Answer", OJSubmitResponse::WA},
+            {"Compile Error", OJSubmitResponse::CE},
+            {"Runtime Error", OJSubmitResponse::RE},
+            {"Time Limit Exceeded", OJSubmitResponse::TLE},
+            {"Memory Limit Exceeded", OJSubmitResponse::MLE},
+            {"Presentation Error", OJSubmitResponse::PE}};
+    return map.value(status, OJSubmitResponse::UKE);
+}
+
+std::expected<OJSubmitResponse, QString>
+OJExtractor::submitResponse(const HtmlDocument &page) {
+    int status = page.find(HtmlDocument::ROOT, "div", "class", "submitStatus");
+    int link = page.find(page.find(status, "p", "class", "compile-status"), "a");
+    if (link < 0) {
+        return std::unexpected("No compile status found!");
+    }
+    QString message;
+    for (int pre: page.findAll(status, "pre")) {
+        // <pre class="sh_sourceCode"> is the code submitted
+        if (!page.hasAttr(pre, "class")) {
+            message += page.text(pre) + '\n';
+        }
+    }
+    return OJSubmitResponse(resultOf(page.text(link).trimmed()), message);
+}
+
+std::expected<OJProblemDetail, QString>
+OJExtractor::problemDetail(const HtmlDocument &page) {
+    int content = page.find(HtmlDocument::ROOT, "div", "class", "problem-content");
+    if (content < 0) {
+        return std::unexpected("解析失败：找不到题目内容区域");
+    }
+    OJProblemDetail detail;
+    detail.title = page.text(page.find(HtmlDocument::ROOT, "h2")).trimmed();
+    if (detail.title.isEmpty()) {
+        detail.title = "未知题目";
+    }
+    for (int section: page.findAll(content, "div", "class", "section")) {
+        int sectionTitle = page.find(section, "div", "class", "section-title");
+        int sectionContent = page.find(section, "div", "class", "section-content");
+        if (sectionTitle < 0 || sectionContent < 0) {
+            continue;
+        }
+        QString title = page.text(sectionTitle).trimmed();
+        QString text = page.text(sectionContent).trimmed();
+        if (title.contains("题目描述")) {
+            detail.description = text;
+        } else if (title.contains("输入") && !title.contains("样例")) {
+            detail.inputDesc = text;
+        } else if (title.contains("输出") && !title.contains("样例")) {
+            detail.outputDesc = text;
+        } else if (title.contains("样例输入")) {
+            detail.sampleInput = text;
+        } else if (title.contains("样例输出")) {
+            detail.sampleOutput = text;
+        } else if (title.contains("提示")) {
+            detail.hint = text;
+        }
+    }
+    return detail;
+}
+
+/** The value of the field of a form, whether it is an input, a textarea or a select */
+static QString fieldOf(const HtmlDocument &page, const QString &name) {
+    int input = page.find(HtmlDocument::ROOT, "input", "name", name);
+    if (input >= 0 && page.hasAttr(input, "value")) {
+        return page.attr(input, "value").trimmed();
+    }
+    int textarea = page.find(HtmlDocument::ROOT, "textarea", "name", name);
+    if (textarea >= 0) {
+        return page.text(textarea).trimmed();
+    }
+    int option = page.find(page.find(HtmlDocument::ROOT, "select", "name", name), "option",
+                           "selected");
+    return option >= 0 ? page.attr(option, "value").trimmed() : "";
+}
+
+std::expected<OJPersonalizationForm, QString>
+OJExtractor::personalizationForm(const HtmlDocument &page) {
+    if (page.find(HtmlDocument::ROOT, "input", "name", "name") < 0) {
+        return std::unexpected("No personalization form found in the file");
+    }
+    OJPersonalizationForm form;
+    form.nickname = fieldOf(page, "name");
+    form.name = fieldOf(page, "realname");
+    form.description = fieldOf(page, "description");
+    form.gender = fieldOf(page, "gender").toLower() == "female" ? OJPersonalizationForm::Female
+                                                                : OJPersonalizationForm::Male;
+    form.birthday = fieldOf(page, "birthday");
+    form.city = fieldOf(page, "city");
+    form.school = fieldOf(page, "school");
+    return form;
+}
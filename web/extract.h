@@ -0,0 +1,28 @@
+#ifndef EXTRACT_H
+#define EXTRACT_H
+
+#include <QString>
+#include <expected>
+
+#include "html.h"
+#include "oj.h"
+
+/**
+ * Read the OJ pages natively, an error means the page is not the one expected, and OJParser has
+ * its script try. Free of the network and the scripts, so the fixtures of test/ run them alone.
+ */
+class OJExtractor {
+public:
+    static std::expected<OJProblem, QString> problem(const HtmlDocument &page);
+    static std::expected<OJMatch, QString> match(const HtmlDocument &page);
+    static std::expected<OJSubmitForm, QString> submitForm(const HtmlDocument &page);
+    static std::expected<OJSubmitResponse, QString> submitResponse(const HtmlDocument &page);
+    static std::expected<OJProblemDetail, QString> problemDetail(const HtmlDocument &page);
+    static std::expected<OJPersonalizationForm, QString>
+    personalizationForm(const HtmlDocument &page);
+
+    /** The verdict of the status shown by OJ, UKE if unknown */
+    static OJSubmitResponse::Result resultOf(const QString &status);
+};
+
+#endif // EXTRACT_H
@@ -0,0 +1,320 @@
+#include "html.h"
+
+#include <QHash>
+#include <QSet>
+#include <algorithm>
+
+static const QSet<QString> VOID_TAGS = {"area",  "base", "br",   "col",    "embed", "hr", "img",
+                                        "input", "link", "meta", "source", "track", "wbr"};
+// their content is not markup, it runs to their end tag
+static const QSet<QString> RAW_TAGS = {"script", "style", "textarea", "title"};
+// an open p ends where one of these starts
+static const QSet<QString> CLOSES_P = {"div", "dl", "h1", "h2",  "h3",    "h4", "h5",
+                                       "h6",  "ol", "p",  "pre", "table", "ul"};
+
+static bool isSpace(QChar c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+HtmlDocument::HtmlDocument(QString html) : source(std::move(html)) {
+    Node root;
+    root.tag = "#document";
+    nodes.append(root);
+    open.append(ROOT);
+
+    qsizetype pos = 0, size = source.size();
+    while (pos < size) {
+        qsizetype lt = source.indexOf('<', pos);
+        if (lt < 0) {
+            addText(QStringView(source).mid(pos));
+            break;
+        }
+        if (lt > pos) {
+            addText(QStringView(source).mid(pos, lt - pos));
+        }
+        QChar next = lt + 1 < size ? source[lt + 1] : QChar();
+        if (QStringView(source).mid(lt, 4) == u"<!--") {
+            qsizetype end = source.indexOf("-->", lt + 4);
+            pos = end < 0 ? size : end + 3;
+        } else if (next == '!' || next == '?') {
+            qsizetype end = source.indexOf('>', lt);
+            pos = end < 0 ? size : end + 1;
+        } else if (next == '/') {
+            qsizetype end = source.indexOf('>', lt);
+            end = end < 0 ? size : end + 1;
+            qsizetype nameEnd = lt + 2;
+            while (nameEnd < end - 1 && !isSpace(source[nameEnd]) && source[nameEnd] != '>') {
+                nameEnd++;
+            }
+            close(source.mid(lt + 2, nameEnd - lt - 2).toLower(), end);
+            pos = end;
+        } else if (next.isLetter()) {
+            pos = readStartTag(lt);
+        } else {
+            addText(u"<");
+            pos = lt + 1;
+        }
+    }
+    while (open.size() > 1) {
+        closeTop(size);
+    }
+    nodes[ROOT].last = static_cast<int>(nodes.size()) - 1;
+    nodes[ROOT].end = size;
+}
+
+qsizetype HtmlDocument::readStartTag(qsizetype pos) {
+    qsizetype size = source.size();
+    Node node;
+    node.begin = pos;
+    qsizetype i = pos + 1;
+    while (i < size && !isSpace(source[i]) && source[i] != '>' && source[i] != '/') {
+        i++;
+    }
+    node.tag = source.mid(pos + 1, i - pos - 1).toLower();
+
+    bool selfClosing = false;
+    while (i < size && source[i] != '>') {
+        if (isSpace(source[i])) {
+            i++;
+            continue;
+        }
+        if (source[i] == '/') {
+            selfClosing = true;
+            i++;
+            continue;
+        }
+        selfClosing = false;
+        qsizetype nameStart = i;
+        while (i < size && !isSpace(source[i]) && source[i] != '=' && source[i] != '>' &&
+               source[i] != '/') {
+            i++;
+        }
+        QString name = source.mid(nameStart, i - nameStart).toLower();
+        while (i < size && isSpace(source[i])) {
+            i++;
+        }
+        QString value;
+        if (i < size && source[i] == '=') {
+            i++;
+            while (i < size && isSpace(source[i])) {
+                i++;
+            }
+            if (i < size && (source[i] == '"' || source[i] == '\'')) {
+                qsizetype close = source.indexOf(source[i], i + 1);
+                close = close < 0 ? size : close;
+                value = decodeEntities(QStringView(source).mid(i + 1, close - i - 1));
+                i = close + 1;
+            } else {
+                qsizetype valueStart = i;
+                while (i < size && !isSpace(source[i]) && source[i] != '>') {
+                    i++;
+                }
+                value = decodeEntities(QStringView(source).mid(valueStart, i - valueStart));
+            }
+        }
+        if (!name.isEmpty()) {
+            node.attrs.append({name, value});
+        }
+    }
+    qsizetype end = i < size ? i + 1 : size;
+
+    // the implied end tags of the elements that cannot nest
+    auto topIs = [this](std::initializer_list<const char *> tags) {
+        const QString &top = nodes[open.last()].tag;
+        return std::any_of(tags.begin(), tags.end(),
+                           [&top](const char *tag) { return top == tag; });
+    };
+    if ((node.tag == "li" && topIs({"li"})) || (node.tag == "option" && topIs({"option"})) ||
+        ((node.tag == "dt" || node.tag == "dd") && topIs({"dt", "dd"})) ||
+        ((node.tag == "td" || node.tag == "th" || node.tag == "tr") && topIs({"td", "th"})) ||
+        (CLOSES_P.contains(node.tag) && topIs({"p"}))) {
+        closeTop(pos);
+    }
+    if (node.tag == "tr" && topIs({"tr"})) {
+        closeTop(pos);
+    }
+
+    node.parent = open.last();
+    int index = static_cast<int>(nodes.size());
+    node.last = index;
+    nodes.append(node);
+
+    if (VOID_TAGS.contains(node.tag) || selfClosing) {
+        nodes[index].end = end;
+        return end;
+    }
+    if (RAW_TAGS.contains(node.tag)) {
+        qsizetype closeTag = source.indexOf("</" + node.tag, end, Qt::CaseInsensitive);
+        closeTag = closeTag < 0 ? size : closeTag;
+        open.append(index);
+        // the code of scripts and styles is not text of the page
+        if (node.tag == "textarea" || node.tag == "title") {
+            addText(QStringView(source).mid(end, closeTag - end));
+        }
+        qsizetype closeEnd = source.indexOf('>', closeTag);
+        closeEnd = closeEnd < 0 ? size : closeEnd + 1;
+        closeTop(closeEnd);
+        return closeEnd;
+    }
+    open.append(index);
+    return end;
+}
+
+void HtmlDocument::addText(QStringView text) {
+    Node node;
+    node.text = decodeEntities(text);
+    node.parent = open.last();
+    node.last = static_cast<int>(nodes.size());
+    nodes.append(node);
+}
+
+void HtmlDocument::closeTop(qsizetype end) {
+    int index = open.takeLast();
+    nodes[index].last = static_cast<int>(nodes.size()) - 1;
+    nodes[index].end = end;
+}
+
+void HtmlDocument::close(const QString &tag, qsizetype end) {
+    for (auto i = open.size() - 1; i > 0; i--) {
+        if (nodes[open[i]].tag != tag) {
+            continue;
+        }
+        while (open.size() > i + 1) {
+            // left open in it, they end where it ends
+            closeTop(end);
+        }
+        closeTop(end);
+        return;
+    }
+}
+
+bool HtmlDocument::matches(int index, const QString &tag, const QString &attr,
+                           const QString &value) const {
+    const auto &node = nodes[index];
+    if (node.tag.isEmpty() || (!tag.isEmpty() && node.tag != tag)) {
+        return false;
+    }
+    if (attr.isEmpty()) {
+        return true;
+    }
+    for (const auto &[name, content]: node.attrs) {
+        if (name != attr) {
+            continue;
+        }
+        if (attr == "class") {
+            return content.simplified().split(' ').contains(value);
+        }
+        return value.isNull() || content == value;
+    }
+    return false;
+}
+
+int HtmlDocument::find(int from, const QString &tag, const QString &attr,
+                       const QString &value) const {
+    if (from < 0) {
+        return -1;
+    }
+    for (int i = from + 1; i <= nodes[from].last; i++) {
+        if (matches(i, tag, attr, value)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+QList<int> HtmlDocument::findAll(int from, const QString &tag, const QString &attr,
+                                 const QString &value) const {
+    QList<int> found;
+    if (from < 0) {
+        return found;
+    }
+    for (int i = from + 1; i <= nodes[from].last; i++) {
+        if (matches(i, tag, attr, value)) {
+            found.append(i);
+        }
+    }
+    return found;
+}
+
+bool HtmlDocument::hasAttr(int index, const QString &name) const {
+    for (const auto &attr: nodes[index].attrs) {
+        if (attr.first == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+QString HtmlDocument::attr(int index, const QString &name) const {
+    for (const auto &attr: nodes[index].attrs) {
+        if (attr.first == name) {
+            return attr.second;
+        }
+    }
+    return {};
+}
+
+QString HtmlDocument::text(int index) const {
+    if (index < 0) {
+        return {};
+    }
+    if (nodes[index].tag.isEmpty()) {
+        return nodes[index].text;
+    }
+    QString text;
+    for (int i = index + 1; i <= nodes[index].last; i++) {
+        text += nodes[i].text;
+    }
+    return text;
+}
+
+QString HtmlDocument::outerHtml(int index) const {
+    const auto &node = nodes[index];
+    return source.mid(node.begin, node.end - node.begin);
+}
+
+int HtmlDocument::nextSibling(int index) const {
+    int next = nodes[index].last + 1;
+    return next < nodes.size() && nodes[next].parent == nodes[index].parent ? next : -1;
+}
+
+QString HtmlDocument::decodeEntities(QStringView text) {
+    static const QHash<QString, QChar> named = {
+            {"amp", '&'},           {"lt", '<'},            {"gt", '>'},
+            {"quot", '"'},          {"apos", '\''},         {"nbsp", QChar(0x00a0)},
+            {"copy", QChar(0x00a9)}, {"middot", QChar(0x00b7)}, {"times", QChar(0x00d7)},
+            {"ndash", QChar(0x2013)}, {"mdash", QChar(0x2014)}, {"lsquo", QChar(0x2018)},
+            {"rsquo", QChar(0x2019)}, {"ldquo", QChar(0x201c)}, {"rdquo", QChar(0x201d)},
+            {"hellip", QChar(0x2026)}, {"le", QChar(0x2264)},   {"ge", QChar(0x2265)},
+    };
+    if (!text.contains('&')) {
+        return text.toString();
+    }
+    QString decoded;
+    decoded.reserve(text.size());
+    for (qsizetype i = 0; i < text.size(); i++) {
+        qsizetype semicolon = text[i] == '&' ? text.indexOf(';', i + 1) : -1;
+        // an entity is short, a lone '&' is kept
+        if (semicolon < 0 || semicolon - i > 10) {
+            decoded += text[i];
+            continue;
+        }
+        auto name = text.mid(i + 1, semicolon - i - 1);
+        bool ok = false;
+        char32_t code = 0;
+        if (name.startsWith('#')) {
+            bool hex = name.size() > 1 && (name[1] == 'x' || name[1] == 'X');
+            code = name.mid(hex ? 2 : 1).toUInt(&ok, hex ? 16 : 10);
+        } else if (auto it = named.find(name.toString()); it != named.end()) {
+            code = it->unicode();
+            ok = true;
+        }
+        if (!ok) {
+            decoded += text[i];
+            continue;
+        }
+        decoded += QString::fromUcs4(&code, 1);
+        i = semicolon;
+    }
+    return decoded;
+}
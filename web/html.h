@@ -0,0 +1,67 @@
+#ifndef HTML_H
+#define HTML_H
+
+#include <QList>
+#include <QPair>
+#include <QString>
+
+/**
+ * A page read in one pass into its elements and texts, enough to pick the parts of OJ pages.
+ * The nodes are kept in the order of the source, so the subtree of a node is the range from it to
+ * its last descendant. Forgiving like the browsers: unknown end tags are dropped, the elements left
+ * open are closed by their parents, and the usual implied end tags (p, li, td, ...) are applied.
+ */
+class HtmlDocument {
+public:
+    struct Node {
+        /** Lower case, empty for a text */
+        QString tag;
+        QList<QPair<QString, QString>> attrs;
+        /** The text with the entities decoded, for a text */
+        QString text;
+        int parent = -1;
+        /** The last node in the subtree */
+        int last = 0;
+        /** Where the element is in the source, its tags included */
+        qsizetype begin = 0;
+        qsizetype end = 0;
+    };
+
+    static constexpr int ROOT = 0;
+
+    explicit HtmlDocument(QString html);
+
+    const Node &node(int index) const { return nodes[index]; }
+    /**
+     * The first element below from with the tag, any tag if empty, and the attribute if given.
+     * The class attribute matches any of the classes of the element. -1 if there is none.
+     */
+    int find(int from, const QString &tag, const QString &attr = {},
+             const QString &value = {}) const;
+    QList<int> findAll(int from, const QString &tag, const QString &attr = {},
+                       const QString &value = {}) const;
+    bool hasAttr(int index, const QString &name) const;
+    QString attr(int index, const QString &name) const;
+    /** All the text below the node, scripts and styles excluded */
+    QString text(int index) const;
+    /** The source of the element as it is in the page */
+    QString outerHtml(int index) const;
+    /** The node right after this one under the same parent, -1 if it is the last */
+    int nextSibling(int index) const;
+
+    static QString decodeEntities(QStringView text);
+
+private:
+    QString source;
+    QList<Node> nodes;
+    QList<int> open;
+
+    bool matches(int index, const QString &tag, const QString &attr, const QString &value) const;
+    qsizetype readStartTag(qsizetype pos);
+    void addText(QStringView text);
+    /** Close the open element with the tag and the ones opened in it, if it is open */
+    void close(const QString &tag, qsizetype end);
+    void closeTop(qsizetype end);
+};
+
+#endif // HTML_H
@@ -0,0 +1,105 @@
+#include "limiter.h"
+
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <algorithm>
+#include <qcorotimer.h>
+
+#include "../util/file.h"
+#include "../util/metrics.h"
+
+// an overloaded host is never slowed down below this
+#define MIN_RATE 0.1 // requests per second
+// the rate regained per successful request after it was halved
+#define RATE_STEP 0.1 // requests per second
+#define MAX_RETRY_DELAY 30000 // ms
+
+static QJsonObject limits() { return Configs::instance().get("rateLimit").toObject(); }
+
+static double maxRate() { return std::max(MIN_RATE, limits().value("perSecond").toDouble(2)); }
+
+static double burst() { return std::max(1.0, limits().value("burst").toDouble(4)); }
+
+static Counter &throttled() {
+    static auto &counter = Metrics::instance().counter(
+            "neverjudge_crawler_throttled_total", "Requests to OJ delayed by the rate limiter.");
+    return counter;
+}
+
+static Counter &retries() {
+    static auto &counter = Metrics::instance().counter("neverjudge_crawler_retries_total",
+                                                       "Requests to OJ sent again after failing.");
+    return counter;
+}
+
+RateLimiter &RateLimiter::instance() {
+    static RateLimiter limiter;
+    return limiter;
+}
+
+RateLimiter::Bucket &RateLimiter::bucketOf(const QUrl &url) {
+    auto it = buckets.find(url.host());
+    if (it == buckets.end()) {
+        it = buckets.insert(url.host(), {burst(), maxRate(), {}});
+        it->refilled.start();
+    }
+    double elapsed = static_cast<double>(it->refilled.restart()) / 1000;
+    it->tokens = std::min(burst(), it->tokens + elapsed * it->rate);
+    return *it;
+}
+
+QCoro::Task<> RateLimiter::acquire(const QUrl &url) {
+    double wait;
+    {
+        // taken now, so the requests after this one wait behind it
+        Bucket &bucket = bucketOf(url);
+        bucket.tokens -= 1;
+        wait = bucket.tokens < 0 ? -bucket.tokens / bucket.rate : 0; // s
+    }
+    if (wait > 0) {
+        throttled().add();
+        co_await QCoro::sleepFor(std::chrono::milliseconds(static_cast<qint64>(wait * 1000)));
+    }
+}
+
+void RateLimiter::feedback(const QNetworkReply *reply) {
+    int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (status == 0) {
+        return; // no answer, which tells nothing of the load of the server
+    }
+    QUrl url = reply->request().url();
+    Bucket &bucket = bucketOf(url);
+    if (status == 429 || status >= 500) {
+        bucket.rate = std::max(MIN_RATE, bucket.rate / 2);
+        qWarning() << "RateLimiter:" << url.host() << "answered" << status << ", down to"
+                   << bucket.rate << "requests/s";
+    } else {
+        bucket.rate = std::min(maxRate(), bucket.rate + RATE_STEP);
+    }
+}
+
+std::optional<std::chrono::milliseconds> RateLimiter::retryDelay(const QNetworkReply *reply,
+                                                                 int attempt) {
+    if (attempt >= limits().value("retries").toInt(3)) {
+        return std::nullopt;
+    }
+    int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    bool overloaded = status == 429 || status >= 500;
+    // the connection failed or timed out rather than the server refusing the page
+    bool transient = status == 0 && reply->error() != QNetworkReply::NoError &&
+                     reply->error() < QNetworkReply::ContentAccessDenied;
+    if (!overloaded && !transient) {
+        return std::nullopt;
+    }
+
+    // doubled each attempt, within [0.5, 1.5] of it so the failed requests spread out
+    double base = limits().value("retryBaseMs").toDouble(500) * (1 << attempt);
+    double delay = base * (0.5 + QRandomGenerator::global()->generateDouble());
+    bool ok;
+    int after = reply->rawHeader("Retry-After").toInt(&ok); // s
+    if (ok) {
+        delay = std::max(delay, after * 1000.0);
+    }
+    retries().add();
+    return std::chrono::milliseconds(static_cast<qint64>(std::min<double>(delay, MAX_RETRY_DELAY)));
+}
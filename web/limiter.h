@@ -0,0 +1,47 @@
+#ifndef LIMITER_H
+#define LIMITER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QNetworkReply>
+#include <QString>
+#include <QUrl>
+#include <chrono>
+#include <optional>
+#include <qcorotask.h>
+
+/**
+ * Keep the requests to each host of OJ under a rate, a token bucket per host.
+ * The rate of a host halves when it answers 429 or 5xx, and grows back by a step on each success
+ * up to the "rateLimit" config. Waiting requests take their turn in the order they came.
+ * Used from the GUI thread.
+ */
+class RateLimiter {
+    struct Bucket {
+        /** Below zero when requests are waiting for the tokens taken ahead */
+        double tokens;
+        double rate; // requests per second
+        QElapsedTimer refilled;
+    };
+
+    QHash<QString, Bucket> buckets;
+
+    RateLimiter() = default;
+    Bucket &bucketOf(const QUrl &url);
+
+public:
+    static RateLimiter &instance();
+
+    /** Wait until the host of the url may take one more request */
+    QCoro::Task<> acquire(const QUrl &url);
+    /** Adapt the rate of the host to the status of its reply */
+    void feedback(const QNetworkReply *reply);
+    /**
+     * How long to wait before the attempt after this one of a GET, none if the failure is not
+     * worth retrying or the attempts are used up. Never used for a submission.
+     */
+    static std::optional<std::chrono::milliseconds> retryDelay(const QNetworkReply *reply,
+                                                               int attempt);
+};
+
+#endif // LIMITER_H
@@ -1,37 +1,115 @@
 #include "parse.h"
 
+#include <QDir>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringDecoder>
+#include <QTemporaryFile>
+
 #include "../util/file.h"
 #include "../util/script.h"
+#include "../util/trace.h"
+#include "../util/watchdog.h"
+#include "cache.h"
 #include "crawl.h"
-
-OJParser::ParseResult<OJProblem> OJParser::parseProblem(const QByteArray &html) {
-    auto tempFile = TempFiles::create("problem", html);
+#include "extract.h"
+
+/**
+ * A file of its own for the page, removed with the pointer, so parses of the same kind can run
+ * at once. Only for the pages that cannot go through stdin.
+ */
+static std::unique_ptr<QTemporaryFile> writeInput(const QString &kind, const QByteArray &html) {
+    WatchdogScope scope("OJParser::writeInput");
+    auto tempFile = std::make_unique<QTemporaryFile>(QDir::tempPath() + "/never-judge-" + kind +
+                                                     "-XXXXXX");
+    if (!tempFile->open() || tempFile->write(html) != html.size()) {
+        qWarning() << "OJParser: cannot write" << tempFile->fileName() << tempFile->errorString();
+    }
     tempFile->close();
+    return tempFile;
+}
+
+/** Whether the page survives the trip through the JSON of the script workers */
+static bool isUtf8(const QByteArray &html) {
+    QStringDecoder decoder(QStringDecoder::Utf8);
+    QString decoded = decoder(html);
+    return !decoder.hasError();
+}
 
-    QFile script = loadRes("script/parser.py");
-    auto output = co_await runPythonScript(script, QStringList() << tempFile->fileName());
+/**
+ * Run the parsing script on the page and get what it prints.
+ * The output is cached for the pages that parse the same every time, keyed by their content.
+ */
+static QCoro::Task<std::expected<QString, QString>>
+runParser(const QString &script, const QString &kind, const QByteArray &html,
+          bool cacheable = false) {
+    QByteArray key = cacheable ? PageCache::parseKey(script, html) : QByteArray();
+    if (cacheable) {
+        if (auto output = PageCache::instance().parsed(key)) {
+            co_return output.value();
+        }
+    }
+    QFile file = loadRes("script/" + script);
+    ScriptResult output;
+    if (isUtf8(html)) {
+        // "-" tells the script to read the page from its stdin
+        output = co_await runPythonScript(file, QStringList() << "-", html);
+    } else {
+        auto tempFile = writeInput(kind, html);
+        output = co_await runPythonScript(file, QStringList() << tempFile->fileName());
+    }
     if (!output.success || output.exitCode != 0) {
         co_return std::unexpected(output.stdErr);
     }
-    auto split = output.stdOut.indexOf('\n');
+    if (cacheable) {
+        PageCache::instance().storeParsed(key, output.stdOut);
+    }
+    co_return output.stdOut;
+}
 
-    QString title = output.stdOut.mid(0, split);
-    QString content = output.stdOut.mid(split + 1);
+/** Read the page natively, an error means the script should have a try */
+template<class T>
+static std::expected<T, QString>
+extract(const QByteArray &html, const char *name,
+        std::expected<T, QString> (*extractor)(const HtmlDocument &)) {
+    WatchdogScope scope(name);
+    auto result = extractor(HtmlDocument(QString::fromUtf8(html)));
+    if (!result.has_value()) {
+        qWarning() << name << "falls back to its script:" << result.error();
+    }
+    return result;
+}
+
+OJParser::ParseResult<OJProblem> OJParser::parseProblem(const QByteArray &html) {
+    TraceSpan span("parser", "OJParser::parseProblem");
+    if (auto result = extract(html, "OJParser::parseProblem", OJExtractor::problem)) {
+        co_return result.value();
+    }
+    auto output = co_await runParser("parser.py", "problem", html, true);
+    if (!output.has_value()) {
+        co_return std::unexpected(output.error());
+    }
+    WatchdogScope scope("OJParser::parseProblem");
+    auto split = output.value().indexOf('\n');
+
+    QString title = output.value().mid(0, split);
+    QString content = output.value().mid(split + 1);
 
     co_return OJProblem(title, content);
 }
 
 OJParser::ParseResult<OJMatch> OJParser::parseMatch(const QByteArray &html) {
-    auto tempFile = TempFiles::create("match", html);
-    tempFile->close();
-
-    QFile script = loadRes("script/match.py");
-    auto output = co_await runPythonScript(script, QStringList() << tempFile->fileName());
-    if (!output.success || output.exitCode != 0) {
-        co_return std::unexpected(output.stdErr);
+    TraceSpan span("parser", "OJParser::parseMatch");
+    if (auto result = extract(html, "OJParser::parseMatch", OJExtractor::match)) {
+        co_return result.value();
     }
+    auto output = co_await runParser("match.py", "match", html, true);
+    if (!output.has_value()) {
+        co_return std::unexpected(output.error());
+    }
+    WatchdogScope scope("OJParser::parseMatch");
     QList<QUrl> urls;
-    for (auto &url: output.stdOut.split("\n", Qt::SkipEmptyParts)) {
+    for (auto &url: output.value().split("\n", Qt::SkipEmptyParts)) {
         urls.append(url);
     }
     co_return OJMatch(urls);
@@ -39,16 +117,18 @@ OJParser::ParseResult<OJMatch> OJParser::parseMatch(const QByteArray &html) {
 
 
 OJParser::ParseResult<OJSubmitForm> OJParser::parseProblemSubmitForm(const QByteArray &html) {
-    auto tempFile = TempFiles::create("submit", html);
-    tempFile->close();
-
-    QFile script = loadRes("script/submit.py");
-    auto output = co_await runPythonScript(script, QStringList() << tempFile->fileName());
-    if (!output.success || output.exitCode != 0) {
-        co_return std::unexpected(output.stdErr);
+    TraceSpan span("parser", "OJParser::parseProblemSubmitForm");
+    if (auto result =
+                extract(html, "OJParser::parseProblemSubmitForm", OJExtractor::submitForm)) {
+        co_return result.value();
+    }
+    auto output = co_await runParser("submit.py", "submit", html);
+    if (!output.has_value()) {
+        co_return std::unexpected(output.error());
     }
+    WatchdogScope scope("OJParser::parseProblemSubmitForm");
 
-    auto lines = output.stdOut.split("\n", Qt::SkipEmptyParts);
+    auto lines = output.value().split("\n", Qt::SkipEmptyParts);
     const QString &contestId = lines[0];
     const QString &problemNumber = lines[1];
     QList<OJLanguage> languages;
@@ -63,81 +143,69 @@ OJParser::ParseResult<OJSubmitForm> OJParser::parseProblemSubmitForm(const QByte
 
 OJParser::ParseResult<OJSubmitResponse>
 OJParser::parseProblemSubmitResponse(const QByteArray &html) {
-    auto tempFile = TempFiles::create("submit_result", html);
-    tempFile->close();
-
-    QFile script = loadRes("script/submit_response.py");
-    auto output = co_await runPythonScript(script, QStringList() << tempFile->fileName());
-    if (!output.success || output.exitCode != 0) {
-        co_return std::unexpected(output.stdErr);
+    TraceSpan span("parser", "OJParser::parseProblemSubmitResponse");
+    if (auto result = extract(html, "OJParser::parseProblemSubmitResponse",
+                              OJExtractor::submitResponse)) {
+        co_return result.value();
     }
+    auto output = co_await runParser("submit_response.py", "submit_result", html);
+    if (!output.has_value()) {
+        co_return std::unexpected(output.error());
+    }
+    WatchdogScope scope("OJParser::parseProblemSubmitResponse");
 
-    static QMap<QString, OJSubmitResponse::Result> map = {
-            {"Waiting", OJSubmitResponse::W},
-            {"Accepted", OJSubmitResponse::AC},
-            {"Wrong Answer", OJSubmitResponse::WA},
-            {"Compile Error", OJSubmitResponse::CE},
-            {"Runtime Error", OJSubmitResponse::RE},
-            {"Time Limit Exceeded", OJSubmitResponse::TLE},
-            {"Memory Limit Exceeded", OJSubmitResponse::MLE},
-            {"Presentation Error", OJSubmitResponse::PE}};
-
-    QString outStr = output.stdOut;
+    QString outStr = output.value();
     auto index = outStr.indexOf('\n');
     QString resStr = outStr.mid(0, index);
-    auto result = map.contains(resStr) ? map[resStr] : OJSubmitResponse::UKE;
+    auto result = OJExtractor::resultOf(resStr);
     auto message = outStr.count('\n') > 1 ? outStr.mid(index + 1) : "";
     co_return OJSubmitResponse(result, message);
 }
 
 OJParser::ParseResult<OJProblemDetail> OJParser::parseProblemDetail(const QByteArray &html) {
-    // Create a temporary file to store page content
-    auto tempFile = TempFiles::create("problem_detail", html);
-    tempFile->close();
-
-    // Use Python script to parse page content
-    QFile script = loadRes("script/problem_detail.py");
-    auto output = co_await runPythonScript(script, QStringList() << tempFile->fileName());
-
-    if (!output.success || output.exitCode != 0) {
-        co_return std::unexpected(output.stdErr);
+    TraceSpan span("parser", "OJParser::parseProblemDetail");
+    if (auto result =
+                extract(html, "OJParser::parseProblemDetail", OJExtractor::problemDetail)) {
+        co_return result.value();
     }
+    auto output = co_await runParser("problem_detail.py", "problem_detail", html, true);
+    if (!output.has_value()) {
+        co_return std::unexpected(output.error());
+    }
+    WatchdogScope scope("OJParser::parseProblemDetail");
 
-    // Parse script output
-    // Output format: title|description|inputDesc|outputDesc|sampleInput|sampleOutput|hint
-    QStringList parts = output.stdOut.split("|", Qt::SkipEmptyParts);
-
-    if (parts.size() < 6) {
-        co_return std::unexpected("Failed to parse problem details: incorrect output format");
+    // a JSON object, the statements may hold any separator
+    QJsonParseError error;
+    QJsonObject obj = QJsonDocument::fromJson(output.value().toUtf8(), &error).object();
+    if (error.error != QJsonParseError::NoError) {
+        co_return std::unexpected("Failed to parse problem details: " + error.errorString());
     }
 
     OJProblemDetail detail;
-    detail.title = parts[0];
-    detail.description = parts[1];
-    detail.inputDesc = parts[2];
-    detail.outputDesc = parts[3];
-    detail.sampleInput = parts[4];
-    detail.sampleOutput = parts[5];
-
-    if (parts.size() > 6) {
-        detail.hint = parts[6];
-    }
+    detail.title = obj.value("title").toString();
+    detail.description = obj.value("description").toString();
+    detail.inputDesc = obj.value("inputDesc").toString();
+    detail.outputDesc = obj.value("outputDesc").toString();
+    detail.sampleInput = obj.value("sampleInput").toString();
+    detail.sampleOutput = obj.value("sampleOutput").toString();
+    detail.hint = obj.value("hint").toString();
     co_return detail;
 }
 
 OJParser::ParseResult<OJPersonalizationForm>
 OJParser::parsePersonalizationForm(const QByteArray &html) {
-
-    auto tempFile = TempFiles::create("personalization", html);
-    tempFile->close();
-
-    QFile script = loadRes("script/personalization.py");
-    auto output = co_await runPythonScript(script, QStringList() << tempFile->fileName());
-    if (!output.success || output.exitCode != 0) {
-        co_return std::unexpected(output.stdErr);
+    TraceSpan span("parser", "OJParser::parsePersonalizationForm");
+    if (auto result = extract(html, "OJParser::parsePersonalizationForm",
+                              OJExtractor::personalizationForm)) {
+        co_return result.value();
+    }
+    auto output = co_await runParser("personalization.py", "personalization", html);
+    if (!output.has_value()) {
+        co_return std::unexpected(output.error());
     }
+    WatchdogScope scope("OJParser::parsePersonalizationForm");
 
-    const auto lines = output.stdOut.split("\n======\n");
+    const auto lines = output.value().split("\n======\n");
     if (lines.size() < 7) {
         co_return std::unexpected("Failed to parse personalization form: incorrect output format");
     }
@@ -0,0 +1,80 @@
+#include "submission.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <algorithm>
+#include <qcorotimer.h>
+
+#include "../util/task.h"
+#include "../util/trace.h"
+#include "cache.h"
+#include "crawl.h"
+#include "parse.h"
+
+#define FIRST_DELAY 1000 // ms
+#define MAX_DELAY 16000 // ms
+// OJ judges in seconds, a submission still waiting after this is left to the user
+#define GIVE_UP_AFTER 300000 // ms
+
+SubmissionTracker::SubmissionTracker() {
+    if (auto *app = QCoreApplication::instance()) {
+        moveToThread(app->thread());
+    }
+}
+
+SubmissionTracker &SubmissionTracker::instance() {
+    static SubmissionTracker tracker;
+    return tracker;
+}
+
+void SubmissionTracker::track(const QUrl &url, const QString &title) { poll(url, title); }
+
+QCoro::Task<> SubmissionTracker::poll(QUrl url, QString title) {
+    TraceSpan span("crawler", "SubmissionTracker::poll");
+    auto task = co_await TaskManager::instance().start(tr("等待 %1 的评测结果").arg(title),
+                                                       TaskResource::None, TaskPriority::Low);
+    QElapsedTimer clock;
+    clock.start();
+    qint64 delay = FIRST_DELAY;
+    QString lastError;
+    int polls = 0;
+
+    while (clock.elapsed() < GIVE_UP_AFTER) {
+        // within [0.75, 1.25] of the delay
+        double jitter = 0.75 + QRandomGenerator::global()->generateDouble() / 2;
+        co_await QCoro::sleepFor(std::chrono::milliseconds(static_cast<qint64>(delay * jitter)));
+        delay = std::min<qint64>(delay * 2, MAX_DELAY);
+        if (task.isCanceled()) {
+            co_return;
+        }
+        if (PageCache::isOffline()) {
+            // the cached page would say waiting forever
+            task.finish();
+            emit failed(title, tr("离线模式下无法获取评测结果"));
+            co_return;
+        }
+
+        task.setText(tr("等待 %1 的评测结果（第 %2 次查询）").arg(title).arg(++polls));
+        auto page = co_await Crawler::instance().get(url);
+        if (task.isCanceled()) {
+            co_return;
+        }
+        if (!page.has_value()) {
+            lastError = page.error(); // may be the network, the next poll tries again
+            continue;
+        }
+        auto response = co_await OJParser::parseProblemSubmitResponse(page.value());
+        if (!response.has_value()) {
+            lastError = response.error();
+            continue;
+        }
+        if (response->result != OJSubmitResponse::W) {
+            task.finish();
+            emit verdictReceived(title, response.value());
+            co_return;
+        }
+    }
+    task.finish();
+    emit failed(title, lastError.isEmpty() ? tr("评测超时，请稍后在网页上查看") : lastError);
+}
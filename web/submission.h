@@ -0,0 +1,33 @@
+#ifndef SUBMISSION_H
+#define SUBMISSION_H
+
+#include <QObject>
+#include <QUrl>
+#include <qcorotask.h>
+
+#include "oj.h"
+
+/**
+ * Poll the result pages of the submissions until OJ judged them, any number of them at once.
+ * The wait between two polls doubles from 1 s up to 16 s, with a random part so submissions made
+ * together do not poll together. A page that did not change is answered with a 304 by the cache
+ * headers of Crawler::get. Every submission is a task of the footer, and can be canceled there.
+ */
+class SubmissionTracker : public QObject {
+    Q_OBJECT
+
+    SubmissionTracker();
+    QCoro::Task<> poll(QUrl url, QString title);
+
+signals:
+    void verdictReceived(const QString &title, const OJSubmitResponse &response);
+    /** Gave up waiting, or the page could not be read */
+    void failed(const QString &title, const QString &error);
+
+public:
+    static SubmissionTracker &instance();
+    /** Start polling the result page of a submission, title is the problem for the messages */
+    void track(const QUrl &url, const QString &title);
+};
+
+#endif // SUBMISSION_H
@@ -142,7 +142,7 @@ QString AIAssistantWidget::getCurrentCode() const {
         return {};
     }
 
-    QString code = currentEdit->toPlainText();
+    QString code = currentEdit->snapshot().text();
     logDebug("Successfully retrieved current code, length: " + QString::number(code.length()) +
              " characters");
     return code;
@@ -401,7 +401,13 @@ void AIAssistantWidget::insertGeneratedCode(const CodeTabWidget *codeTabWidget)
         return;
     }
 
-    editor->insertPlainText(generatedCode);
+    auto cursor = editor->textCursor();
+    if (cursor.hasSelection()) {
+        // usually a revision of the selected code, so only the lines that differ are edited
+        editor->replaceText(cursor.selectionStart(), cursor.selectionEnd(), generatedCode);
+    } else {
+        editor->insertPlainText(generatedCode);
+    }
     QMessageBox::information(this, tr("代码已插入"), tr("代码已成功插入到编辑器中。"));
 }
 
@@ -557,7 +563,7 @@ bool AIAssistantWidget::getProblemInfoFromPreview(const OpenJudgePreviewWidget *
 }
 
 QCoro::Task<bool> AIAssistantWidget::getProblemInfoFromUrl(const QUrl &url) {
-    auto response = co_await Crawler::instance().get(url);
+    auto response = co_await Crawler::instance().get(url, TaskPriority::Normal, true);
     if (!response.has_value()) {
         const QString &errorMsg = response.error();
         logDebug("Failed to get problem: " + errorMsg);
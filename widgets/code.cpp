@@ -1,13 +1,25 @@
+#include <QDir>
 #include <QFile>
 #include <QMessageBox>
+#include <QPaintEvent>
 #include <QPainter>
 #include <QVBoxLayout>
+#include <algorithm>
+#include <utility>
 
+#include "../ide/diff.h"
 #include "../ide/highlighter.h"
 #include "../ide/lsp.h"
+#include "../ide/save.h"
 #include "../util/file.h"
+#include "../util/metrics.h"
+#include "../util/watchdog.h"
 #include "code.h"
 
+#include <QApplication>
+#include <QPointer>
+#include <QScopedValueRollback>
+#include <QScrollBar>
 #include <QThread>
 #include <QTimer>
 
@@ -152,6 +164,7 @@ int LineNumberArea::getWidth() const {
 QSize LineNumberArea::sizeHint() const { return {getWidth(), 0}; }
 
 void LineNumberArea::paintEvent(QPaintEvent *event) {
+    LatencyScope scope(LatencyPhase::LineNumbers);
     QPainter painter(this);
     painter.fillRect(event->rect(), QColor(0x252526));
 
@@ -191,6 +204,9 @@ const int LineNumberArea::R_MARGIN = 5;
 
 WelcomeWidget::WelcomeWidget(QWidget *parent) : QWidget(parent) { setup(); }
 
+TabPlaceholder::TabPlaceholder(TabState state, QWidget *parent) :
+    QWidget(parent), state(std::move(state)) {}
+
 void WelcomeWidget::setup() {
     auto *mainLayout = new QVBoxLayout(this);
     mainLayout->setAlignment(Qt::AlignCenter);
@@ -222,14 +238,34 @@ void WelcomeWidget::setup() {
 
 /* Code plain text edit widget */
 
+static Gauge &openDocuments() {
+    static auto &gauge = Metrics::instance().gauge(
+            "neverjudge_open_documents", "Documents open in editors, hibernated tabs excluded.");
+    return gauge;
+}
+
 CodeEditWidget::CodeEditWidget(const QString &filename, QWidget *parent) :
-    QPlainTextEdit(parent), server(nullptr), modified(false), requireCompletion(true) {
+    QPlainTextEdit(parent), server(nullptr), modified(false), requireCompletion(true),
+    searchDone(true), jumpToMatch(false) {
+    openDocuments().add(1);
     lna = new LineNumberArea(this);
     cl = new CompletionList(this);
+    findBar = new FindBarWidget(this);
+    findBar->hide();
+    latencyLabel = new QLabel(this);
+    latencyLabel->setObjectName("latencyLabel");
+    latencyLabel->hide();
+    search = new TextSearch(this);
     file = LangFileInfo(filename);
+    buffer = TextBuffer::of(document());
     highlighter = HighlighterFactory::getHighlighter(file.language(), document());
 
     readFile();
+    // loading the file is not an edit, only the highlighter listens yet, which parses it
+    buffer->flush();
+    diskContent = buffer->snapshot();
+    // binary and large files are never written back, so there is nothing to journal
+    journal = isReadOnly() ? nullptr : new EditJournal(file.filePath(), buffer, this);
     setup();
     adaptViewport();
 
@@ -237,33 +273,100 @@ CodeEditWidget::CodeEditWidget(const QString &filename, QWidget *parent) :
     connect(this, &CodeEditWidget::blockCountChanged, this, &CodeEditWidget::adaptViewport);
     connect(this, &CodeEditWidget::updateRequest, this, &CodeEditWidget::updateLineNumberArea);
     connect(this, &CodeEditWidget::cursorPositionChanged, this, &CodeEditWidget::highlightLine);
-    connect(this, &QPlainTextEdit::textChanged, this, &CodeEditWidget::onTextChanged);
+    connect(buffer, &TextBuffer::changed, this, &CodeEditWidget::onTextChanged);
     connect(cl, &CompletionList::completionSelected, this, &CodeEditWidget::insertCompletion);
     connect(this, &CodeEditWidget::toggleComment, this, &CodeEditWidget::onToggleComment);
     connect(this, &CodeEditWidget::jumpToDefinition, this, &CodeEditWidget::askForDefinition);
 
+    // Find and replace
+    researchTimer.setSingleShot(true);
+    researchTimer.setInterval(200);
+    connect(&researchTimer, &QTimer::timeout, this, [this] { onQueryChanged(findBar->query()); });
+    connect(findBar, &FindBarWidget::queryChanged, this, [this](const SearchQuery &query) {
+        jumpToMatch = true;
+        onQueryChanged(query);
+    });
+    connect(findBar, &FindBarWidget::findNext, this, &CodeEditWidget::findNext);
+    connect(findBar, &FindBarWidget::findPrevious, this, &CodeEditWidget::findPrevious);
+    connect(findBar, &FindBarWidget::replaceOne, this, &CodeEditWidget::replaceOne);
+    connect(findBar, &FindBarWidget::replaceAll, this, &CodeEditWidget::replaceAll);
+    connect(findBar, &FindBarWidget::closed, this, &CodeEditWidget::onFindBarClosed);
+    connect(search, &TextSearch::matchesFound, this, &CodeEditWidget::onMatchesFound);
+    connect(search, &TextSearch::searchFinished, this, &CodeEditWidget::onSearchFinished);
+    connect(search, &TextSearch::replaceReady, this, &CodeEditWidget::onReplaceReady);
+    connect(this, &CodeEditWidget::cursorPositionChanged, this, &CodeEditWidget::updateMatchCount);
+
     emit setupFinished();
 }
 
+CodeEditWidget::~CodeEditWidget() {
+    openDocuments().add(-1);
+    // the journal must get the last edits, but not this half destroyed editor
+    disconnect(buffer, nullptr, this, nullptr);
+    buffer->flush();
+    if (server) {
+        server->didClose({LSPUri::fromQUrl(file.filePath())});
+    }
+}
+
 QCoro::Task<> CodeEditWidget::onSetupFinished() {
-    if (highlighter) {
-        highlighter->parseDocument();
+    // the tab may be closed or hibernated while waiting for the server
+    QPointer self(this);
+    auto *languageServer = co_await LanguageServers::get(file.language());
+    if (!self || languageServer == nullptr) {
+        co_return;
     }
-    server = co_await LanguageServers::get(file.language());
-    if (server == nullptr) {
+    auto response = co_await languageServer->initialize(file.path(), {});
+    if (!self) {
         co_return;
     }
-    auto response = co_await server->initialize(file.path(), {});
     if (!response.ok) {
         qWarning() << "Server of language" << langName(file.language()) << "initialized failed";
     }
-    co_await server->didOpen({LSPUri::fromQUrl(file.filePath()), file.language(), toPlainText()});
+    // the pending edits go into the opened text, flushing them calls syncServer before didOpen
+    buffer->flush();
+    co_await languageServer->didOpen({LSPUri::fromQUrl(file.filePath()), file.language(),
+                                      buffer->snapshot().text(),
+                                      static_cast<int>(buffer->version())});
+    // the changes after this are sent by syncServer
+    server = languageServer;
     co_return;
 }
 
 void CodeEditWidget::setup() {
     Configs::bindHotUpdateOn(this, "codeFont", &CodeEditWidget::onSetFont);
     Configs::instance().manuallyUpdate("codeFont");
+    Configs::bindHotUpdateOn(this, "latencyOverlay", &CodeEditWidget::onSetLatencyOverlay);
+    onSetLatencyOverlay(Configs::instance().get("latencyOverlay").toBool());
+}
+
+void CodeEditWidget::onSetLatencyOverlay(const bool &enabled) {
+    // only connected while shown, the probe itself always runs
+    disconnect(&LatencyProbe::instance(), &LatencyProbe::sampleRecorded, this, nullptr);
+    latencyLabel->setVisible(enabled);
+    if (enabled) {
+        connect(&LatencyProbe::instance(), &LatencyProbe::sampleRecorded, this,
+                &CodeEditWidget::showLatency);
+        latencyLabel->setText(tr("输入延迟：等待输入"));
+        latencyLabel->adjustSize();
+        placeOverlays();
+    }
+}
+
+void CodeEditWidget::showLatency(const LatencySample &sample) {
+    auto &probe = LatencyProbe::instance();
+    QString text = tr("输入延迟 %1 ms（p50 ≤ %2，p99 ≤ %3）")
+                           .arg(static_cast<double>(sample.total) / 1e6, 0, 'f', 1)
+                           .arg(probe.percentile(0.5))
+                           .arg(probe.percentile(0.99));
+    for (int i = 0; i < LATENCY_PHASES; ++i) {
+        text += QString("\n%1 %2 ms")
+                        .arg(LatencyProbe::phaseName(static_cast<LatencyPhase>(i)))
+                        .arg(static_cast<double>(sample.phases[i]) / 1e6, 0, 'f', 2);
+    }
+    latencyLabel->setText(text);
+    latencyLabel->adjustSize();
+    placeOverlays();
 }
 
 void CodeEditWidget::onSetFont(const QJsonValue &fontJson) {
@@ -285,16 +388,92 @@ void CodeEditWidget::resizeEvent(QResizeEvent *event) {
 
     auto cr = contentsRect();
     lna->setGeometry(QRect(cr.left(), cr.top(), lna->getWidth(), cr.height()));
+    placeOverlays();
+}
+
+void CodeEditWidget::placeOverlays() {
+    auto vp = viewport()->geometry();
+    findBar->move(vp.right() - findBar->width() - 10, vp.top() + 6);
+    latencyLabel->move(vp.right() - latencyLabel->width() - 10,
+                       vp.bottom() - latencyLabel->height() - 6);
+}
+
+void CodeEditWidget::paintEvent(QPaintEvent *event) {
+    QPlainTextEdit::paintEvent(event);
+    if (!matches.isEmpty()) {
+        QPainter painter(viewport());
+        paintMatches(painter, event->rect());
+    }
+    LatencyProbe::instance().painted();
+}
+
+void CodeEditWidget::paintMatches(QPainter &painter, const QRect &area) {
+    const QColor color(0xFF, 0xC8, 0x00, 0x50);
+    auto offset = contentOffset();
+    QTextBlock block = firstVisibleBlock();
+    // the first match not ending before the first visible block
+    auto it = std::lower_bound(matches.cbegin(), matches.cend(), block.position(),
+                               [](const TextMatch &m, qsizetype position) {
+                                   return m.offset + m.length <= position;
+                               });
+
+    while (block.isValid() && it != matches.cend()) {
+        QRectF geometry = blockBoundingGeometry(block).translated(offset);
+        if (geometry.top() > area.bottom()) {
+            break;
+        }
+        qsizetype start = block.position();
+        qsizetype end = start + block.length(); // including the paragraph separator
+        if (block.isVisible() && geometry.bottom() >= area.top()) {
+            auto *layout = block.layout();
+            for (auto m = it; m != matches.cend() && m->offset < end; ++m) {
+                // [from, to] in the block, to is at the separator when the match goes on
+                qsizetype from = qMax(m->offset, start) - start;
+                qsizetype to = qMin(m->offset + m->length, end - 1) - start;
+                for (int i = 0; i < layout->lineCount(); ++i) {
+                    QTextLine line = layout->lineAt(i);
+                    qsizetype a = qMax<qsizetype>(from, line.textStart());
+                    qsizetype b = qMin<qsizetype>(to, line.textStart() + line.textLength());
+                    if (a > b || (a == b && from != to)) {
+                        continue;
+                    }
+                    qreal x1 = line.cursorToX(static_cast<int>(a));
+                    qreal x2 = line.cursorToX(static_cast<int>(b));
+                    // a match of the line break only is shown as a thin bar
+                    painter.fillRect(QRectF(geometry.left() + x1, geometry.top() + line.y(),
+                                            qMax<qreal>(x2 - x1, 3), line.height()),
+                                     color);
+                }
+            }
+        }
+        while (it != matches.cend() && it->offset + it->length <= end) {
+            ++it;
+        }
+        block = block.next();
+    }
 }
 
 
 void CodeEditWidget::keyPressEvent(QKeyEvent *e) {
+    auto &probe = LatencyProbe::instance();
+    bool started = probe.keyPressed();
+    int revision = document()->revision();
+    QTextCursor before = textCursor();
+
     QPlainTextEdit::keyPressEvent(e);
+    bool accepted = e->isAccepted();
     if (e->key() == Qt::Key_Slash && e->modifiers() & Qt::ControlModifier) {
+        accepted = true; // handled here rather than by the base class
         emit toggleComment();
-        return;
+    } else {
+        updateCursorPosition();
     }
-    updateCursorPosition();
+    // the edits of the key are dispatched now rather than by the buffer timer, so its highlight
+    // and completion are done before the paint that ends the sample
+    buffer->flush();
+    // only a key showing a change is measured, a lone Shift waits for the cursor blink
+    probe.keyHandled(started, accepted && (document()->revision() != revision ||
+                                           textCursor() != before));
 }
 
 void CodeEditWidget::mousePressEvent(QMouseEvent *e) {
@@ -336,11 +515,6 @@ QCoro::Task<> CodeEditWidget::askForCompletion() const {
         co_return;
     }
 
-    if (modified) {
-        co_await server->didOpen(
-                {LSPUri::fromQUrl(file.filePath()), file.language(), toPlainText()});
-    }
-
     auto completion = co_await server->completion({LSPUri::fromQUrl(file.filePath())},
                                                   {cursor.blockNumber(), cursor.columnNumber()});
     for (const auto &item: completion.items) {
@@ -358,6 +532,7 @@ QCoro::Task<> CodeEditWidget::askForCompletion() const {
 }
 
 void CodeEditWidget::updateCompletionList() {
+    LatencyScope scope(LatencyPhase::Completion);
     auto cursor = textCursor();
     cursor.select(QTextCursor::WordUnderCursor);
     auto word = cursor.selectedText();
@@ -464,13 +639,14 @@ void CodeEditWidget::onToggleComment() {
 }
 
 QCoro::Task<> CodeEditWidget::askForDefinition() {
-    QTextCursor cursor = textCursor();
-
-    if (modified) {
-        co_await server->didOpen(
-                {LSPUri::fromQUrl(file.filePath()), file.language(), toPlainText()});
+    if (!server) {
+        co_return;
     }
 
+    QTextCursor cursor = textCursor();
+    // the server must know the edits just made
+    buffer->flush();
+
     auto definition = co_await server->definition({LSPUri::fromQUrl(file.filePath())},
                                                   {cursor.blockNumber(), cursor.columnNumber()});
     if (definition.items.isEmpty()) {
@@ -496,9 +672,12 @@ void CodeEditWidget::updateLineNumberArea(const QRect &rect, int dy) {
 
 const LangFileInfo &CodeEditWidget::getFile() const { return file; }
 
+TextSnapshot CodeEditWidget::snapshot() const { return buffer->snapshot(); }
+
 QString CodeEditWidget::getTabText() const { return file.fileName(); };
 
 void CodeEditWidget::highlightLine() {
+    LatencyScope scope(LatencyPhase::ExtraSelections);
     QList<QTextEdit::ExtraSelection> selections;
     if (!isReadOnly()) {
         QTextEdit::ExtraSelection selection;
@@ -515,6 +694,7 @@ void CodeEditWidget::highlightLine() {
 #define MAX_BUFFER_SIZE (1024 * 1024)
 
 void CodeEditWidget::readFile() {
+    WatchdogScope scope("CodeEditWidget::readFile");
     QFile check(file.filePath());
     if (!check.open(QIODevice::ReadOnly | QIODevice::Text)) {
         qWarning() << "CodeEditWidget::readFile: Failed to open file " << file.filePath();
@@ -563,32 +743,125 @@ void CodeEditWidget::readFile() {
     check.close();
 }
 
-void CodeEditWidget::saveFile() {
-    QFile qfile(file.filePath());
-    if (!qfile.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        QMessageBox::warning(this, "错误",
-                             tr("文件 %1 保存失败, 请检查用户权限！").arg(file.filePath()));
+void CodeEditWidget::recoverFromJournal() {
+    if (!journal) {
+        return;
+    }
+    auto recovered = EditJournal::recover(file.filePath(), buffer->snapshot().text());
+    if (!recovered) {
+        return;
+    }
+    QMessageBox::StandardButton reply = QMessageBox::question(
+            this, tr("恢复文件"), tr("文件 %1 有上次未保存的修改，是否恢复？").arg(file.fileName()),
+            QMessageBox::Yes | QMessageBox::No);
+    if (reply != QMessageBox::Yes) {
+        journal->discard();
+        return;
+    }
+    // edit through a cursor, so the recovery can be undone and is journaled again
+    replaceText(0, buffer->snapshot().length(), *recovered);
+}
+
+void CodeEditWidget::reloadFile() {
+    if (isReadOnly()) {
+        return;
+    }
+    QFile read(file.filePath());
+    // a deleted file keeps its content in the editor
+    if (read.size() > MAX_BUFFER_SIZE || !read.open(QIODevice::ReadOnly | QIODevice::Text)) {
         return;
     }
+    QString content = read.readAll();
+    if (content == diskContent.text() || (saving.has_value() && content == saving->text())) {
+        return; // saved by ourselves, or only touched
+    }
+    diskContent = TextSnapshot(content);
+    if (modified) {
+        auto reply = QMessageBox::question(
+                this, tr("文件已更改"),
+                tr("文件 %1 已被其他程序修改，是否重新加载？未保存的修改将丢失。")
+                        .arg(file.fileName()),
+                QMessageBox::Yes | QMessageBox::No);
+        if (reply != QMessageBox::Yes) {
+            return;
+        }
+    }
+    replaceText(0, buffer->snapshot().length(), content);
+    // the edits are dispatched now, so they do not mark it as modified later
+    buffer->flush();
     modified = false;
-    qfile.write(toPlainText().toUtf8());
-    qfile.close();
+    emit saved();
+    if (journal) {
+        journal->rebase(buffer->snapshot());
+    }
+}
+
+void CodeEditWidget::replaceText(qsizetype from, qsizetype to, const QString &text) {
+    auto hunks = TextDiff::compute(buffer->snapshot().mid(from, to - from), text);
+    if (hunks.isEmpty()) {
+        return;
+    }
+    QTextCursor cursor(document());
+    cursor.beginEditBlock();
+    // from the last one, so the positions of the others stay valid
+    for (auto it = hunks.crbegin(); it != hunks.crend(); ++it) {
+        cursor.setPosition(static_cast<int>(from + it->position));
+        cursor.setPosition(static_cast<int>(from + it->position + it->charsRemoved),
+                           QTextCursor::KeepAnchor);
+        cursor.insertText(it->added);
+    }
+    cursor.endEditBlock();
+}
+
+bool CodeEditWidget::isModified() const { return modified; }
+
+QCoro::Task<bool> CodeEditWidget::saveFile() {
+    if (isReadOnly()) {
+        // binary or large files only show a placeholder, never write it back
+        co_return true;
+    }
+    QPointer self(this);
+    QString path = file.filePath();
+    auto snapshot = buffer->snapshot();
+
+    saving = snapshot;
+    auto res = co_await FileSaver::save(path, snapshot);
+    if (!self) {
+        co_return res.has_value();
+    }
+    saving.reset();
+    if (!res.has_value()) {
+        QMessageBox::warning(this, "错误",
+                             tr("文件 %1 保存失败: %2").arg(path, res.error()));
+        co_return false;
+    }
+    diskContent = snapshot;
+    if (journal) {
+        journal->rebase(snapshot);
+    }
+    // the user may have typed during the save, then it is still modified
+    if (buffer->snapshot().isIdenticalTo(snapshot)) {
+        modified = false;
+        emit saved();
+    }
+    co_return true;
 }
 
-bool CodeEditWidget::askForSave() {
+QCoro::Task<bool> CodeEditWidget::askForSave() {
     if (!modified) {
-        return true;
+        co_return true;
     }
     // if the content is modified, ask for save
     QMessageBox::StandardButton reply =
             QMessageBox::question(this, tr("保存文件"), tr("文件已修改，是否保存？"),
                                   QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel);
     if (reply == QMessageBox::Yes) {
-        saveFile();
-    } else if (reply == QMessageBox::Cancel) {
-        return false;
+        co_return co_await saveFile();
     }
-    return true;
+    if (reply == QMessageBox::No && journal) {
+        journal->discard();
+    }
+    co_return reply != QMessageBox::Cancel;
 }
 
 void CodeEditWidget::cursorMoveTo(int startLine, int startChar, int endLine, int endChar) {
@@ -613,18 +886,51 @@ void CodeEditWidget::cursorMoveTo(int startLine, int startChar, int endLine, int
 }
 
 
-QCoro::Task<> CodeEditWidget::onTextChanged() {
-    // This is a hack!
-    // If highlighter has not changed the text, we should not emit modify signal
-    if (highlighter && highlighter->textNotChanged) {
-        highlighter->textNotChanged = false;
-        co_return;
-    }
-
+void CodeEditWidget::onTextChanged(const TextChanges &changes) {
     if (!modified) {
         modified = true;
         emit modify();
     }
+    syncServer(changes);
+    if (!findBar->isHidden()) {
+        // the running search works on the old text, its results are useless now
+        search->cancel();
+        researchTimer.start();
+        for (const auto &change: changes.changes) {
+            shiftMatches(change);
+        }
+        viewport()->update();
+    }
+    completeAfterEdit();
+}
+
+#define MAX_INCREMENTAL_CHANGES 64
+
+void CodeEditWidget::syncServer(const TextChanges &changes) {
+    if (!server) {
+        return; // the text is sent with didOpen when the server is ready
+    }
+    QList<LSPTextChange> contentChanges;
+    if (changes.changes.size() > MAX_INCREMENTAL_CHANGES) {
+        // cheaper to send the whole text than so many ranges
+        contentChanges.append({std::nullopt, changes.after.text()});
+    } else {
+        // the range of each change is in the text left by the previous one
+        auto current = changes.before;
+        for (const auto &[position, charsRemoved, added, _]: changes.changes) {
+            auto start = current.positionAt(position);
+            auto end = current.positionAt(position + charsRemoved);
+            contentChanges.append(
+                    {LSPRange{{start.line, start.column}, {end.line, end.column}}, added});
+            current = current.replaced(position, charsRemoved, added);
+        }
+    }
+    LSPTextDocument document{LSPUri::fromQUrl(file.filePath()), file.language()};
+    document.version = static_cast<int>(changes.changes.last().version);
+    server->didChange(document, contentChanges);
+}
+
+QCoro::Task<> CodeEditWidget::completeAfterEdit() {
     if (requireCompletion) {
         co_await askForCompletion();
     }
@@ -632,18 +938,344 @@ QCoro::Task<> CodeEditWidget::onTextChanged() {
     co_return;
 }
 
+void CodeEditWidget::showFindBar(bool replace) {
+    auto cursor = textCursor();
+    QString selected = cursor.selectedText();
+    // a selection over lines is not a good query
+    if (selected.contains(QChar::ParagraphSeparator)) {
+        selected.clear();
+    }
+    findBar->activate(selected, replace);
+    placeOverlays();
+}
+
+TabState CodeEditWidget::tabState() const {
+    return {file.filePath(), textCursor().position(), verticalScrollBar()->value()};
+}
+
+void CodeEditWidget::restoreTabState(const TabState &state) {
+    auto cursor = textCursor();
+    cursor.setPosition(qBound(0, state.cursor, document()->characterCount() - 1));
+    setTextCursor(cursor);
+    // the scroll bar gets its range after the layout
+    QTimer::singleShot(0, this,
+                       [this, scroll = state.scroll] { verticalScrollBar()->setValue(scroll); });
+}
+
+void CodeEditWidget::restoreUnsaved(const QString &text) {
+    // only the lines edited before hibernating are touched, and journaled again
+    replaceText(0, buffer->snapshot().length(), text);
+    // marked as modified now, saveAll and closing the tab ask right after materializing it
+    buffer->flush();
+}
+
+// bytes per character held by the layout, the formats and the syntax tree, roughly
+#define COST_PER_CHAR 32
+// the widgets, the highlighter queries and so on
+#define BASE_COST (256 * 1024)
+
+qint64 CodeEditWidget::memoryCost() const {
+    return static_cast<qint64>(buffer->snapshot().length()) * COST_PER_CHAR + BASE_COST;
+}
+
+void CodeEditWidget::onQueryChanged(const SearchQuery &query) {
+    // the matches are shifted by the changes dispatched after this snapshot
+    buffer->flush();
+    researchTimer.stop();
+    matches.clear();
+    searchDone = false;
+    search->find(buffer->snapshot(), query);
+    updateMatchCount();
+    viewport()->update();
+}
+
+void CodeEditWidget::onMatchesFound(const QList<TextMatch> &found) {
+    matches.append(found);
+    if (jumpToMatch) {
+        // select the first match after the cursor, as soon as it is found
+        qsizetype position = textCursor().selectionStart();
+        auto it = std::lower_bound(
+                found.cbegin(), found.cend(), position,
+                [](const TextMatch &m, qsizetype position) { return m.offset < position; });
+        if (it != found.cend()) {
+            jumpToMatch = false;
+            selectMatch(*it);
+        }
+    }
+    updateMatchCount();
+    viewport()->update();
+}
+
+void CodeEditWidget::onSearchFinished(int) {
+    searchDone = true;
+    if (jumpToMatch && !matches.isEmpty()) {
+        selectMatch(matches.first()); // wrap around
+    }
+    jumpToMatch = false;
+    updateMatchCount();
+}
+
+void CodeEditWidget::shiftMatches(const TextChange &change) {
+    const auto &[position, charsRemoved, added, _] = change;
+    qsizetype delta = added.length() - charsRemoved;
+    auto first = std::lower_bound(
+            matches.begin(), matches.end(), position,
+            [](const TextMatch &m, qsizetype position) { return m.offset + m.length <= position; });
+    auto last = first;
+    while (last != matches.end() && last->offset < position + charsRemoved) {
+        ++last; // touched by the edit
+    }
+    for (auto it = last; it != matches.end(); ++it) {
+        it->offset += delta;
+    }
+    matches.erase(first, last);
+}
+
+void CodeEditWidget::selectMatch(const TextMatch &match) {
+    auto cursor = textCursor();
+    cursor.setPosition(static_cast<int>(match.offset));
+    cursor.setPosition(static_cast<int>(match.offset + match.length), QTextCursor::KeepAnchor);
+    setTextCursor(cursor);
+    ensureCursorVisible();
+}
+
+int CodeEditWidget::currentMatch() const {
+    auto cursor = textCursor();
+    qsizetype start = cursor.selectionStart();
+    auto it = std::lower_bound(
+            matches.cbegin(), matches.cend(), start,
+            [](const TextMatch &m, qsizetype position) { return m.offset < position; });
+    if (it != matches.cend() && it->offset == start &&
+        it->offset + it->length == cursor.selectionEnd()) {
+        return static_cast<int>(it - matches.cbegin());
+    }
+    return -1;
+}
+
+void CodeEditWidget::updateMatchCount() {
+    if (findBar->isVisible()) {
+        findBar->setCount(currentMatch() + 1, static_cast<int>(matches.size()), searchDone);
+    }
+}
+
+void CodeEditWidget::findNext() {
+    if (matches.isEmpty()) {
+        return;
+    }
+    qsizetype end = textCursor().selectionEnd();
+    auto it = std::lower_bound(
+            matches.cbegin(), matches.cend(), end,
+            [](const TextMatch &m, qsizetype position) { return m.offset < position; });
+    selectMatch(it == matches.cend() ? matches.first() : *it);
+}
+
+void CodeEditWidget::findPrevious() {
+    if (matches.isEmpty()) {
+        return;
+    }
+    qsizetype start = textCursor().selectionStart();
+    auto it = std::lower_bound(
+            matches.cbegin(), matches.cend(), start,
+            [](const TextMatch &m, qsizetype position) { return m.offset < position; });
+    selectMatch(it == matches.cbegin() ? matches.last() : *(it - 1));
+}
+
+void CodeEditWidget::replaceOne(const QString &replacement) {
+    int index = currentMatch();
+    if (isReadOnly() || index < 0) {
+        findNext();
+        return;
+    }
+    auto match = matches[index];
+    auto query = findBar->query();
+    QString text = replacement;
+    if (query.regex) {
+        // match again in place, so anchors and lookarounds see the context
+        auto result = query.expression().match(buffer->snapshot().text(), match.offset,
+                                               QRegularExpression::NormalMatch,
+                                               QRegularExpression::AnchorAtOffsetMatchOption);
+        if (!result.hasMatch()) {
+            return;
+        }
+        text = TextSearch::replacementOf(result, replacement);
+    }
+    auto cursor = textCursor();
+    cursor.insertText(text);
+    setTextCursor(cursor);
+    findNext();
+}
+
+void CodeEditWidget::replaceAll(const QString &replacement) {
+    if (isReadOnly()) {
+        return;
+    }
+    lastReplacement = replacement;
+    search->replaceAll(buffer->snapshot(), findBar->query(), replacement);
+}
+
+void CodeEditWidget::onReplaceReady(const TextSnapshot &source, qsizetype from, qsizetype to,
+                                    const QString &text, int count) {
+    if (!buffer->snapshot().isIdenticalTo(source)) {
+        // edited while replacing, do it again on the new text
+        search->replaceAll(buffer->snapshot(), findBar->query(), lastReplacement);
+        return;
+    }
+    if (count == 0) {
+        return;
+    }
+    // a single edit, so it is undone in one step and the document only changes once
+    QTextCursor cursor(document());
+    cursor.beginEditBlock();
+    cursor.setPosition(static_cast<int>(from));
+    cursor.setPosition(static_cast<int>(to), QTextCursor::KeepAnchor);
+    cursor.insertText(text);
+    cursor.endEditBlock();
+}
+
+void CodeEditWidget::onFindBarClosed() {
+    search->cancel();
+    researchTimer.stop();
+    matches.clear();
+    viewport()->update();
+    setFocus();
+}
+
 /* Code tab widget */
 
+// check for idle tabs every minute
+#define HIBERNATE_CHECK_INTERVAL 60000
+// a checkout or a formatter writes many files at once, reload when they are quiet (ms)
+#define RELOAD_DELAY 200
+
 CodeTabWidget::CodeTabWidget(QWidget *parent) : QTabWidget(parent) {
     setup();
     welcome();
     connect(this, &QTabWidget::tabCloseRequested, this, &CodeTabWidget::removeCodeEditRequested);
     connect(this, &QTabWidget::currentChanged, this, &CodeTabWidget::onCurrentTabChanged);
+    connect(tabBar(), &QTabBar::tabMoved, this, &CodeTabWidget::scheduleSessionSave);
+
+    sessionTimer.setSingleShot(true);
+    sessionTimer.setInterval(2000);
+    connect(&sessionTimer, &QTimer::timeout, this, &CodeTabWidget::saveSession);
+    warmUpTimer.setInterval(300);
+    connect(&warmUpTimer, &QTimer::timeout, this, &CodeTabWidget::warmUpNext);
+    hibernateTimer.setInterval(HIBERNATE_CHECK_INTERVAL);
+    connect(&hibernateTimer, &QTimer::timeout, this, &CodeTabWidget::applyMemoryBudget);
+    hibernateTimer.start();
+    reloadTimer.setSingleShot(true);
+    reloadTimer.setInterval(RELOAD_DELAY);
+    connect(&reloadTimer, &QTimer::timeout, this, &CodeTabWidget::reloadChangedFiles);
+    connect(&watcher, &QFileSystemWatcher::fileChanged, this, &CodeTabWidget::onFileChanged);
+    // the window is never destroyed, so save when the application quits
+    connect(qApp, &QCoreApplication::aboutToQuit, this, &CodeTabWidget::saveSession);
 }
 
 void CodeTabWidget::setProject(Project *project) {
+    saveSession(); // of the last project
+    warmUpTimer.stop();
+    warmUpQueue.clear();
+    recent.clear();
+    lastUsed.clear();
+
     this->project = project;
+    sessionRoot = project->getRoot();
     clearAll();
+    restoreSession();
+    restoreJournals();
+}
+
+void CodeTabWidget::restoreSession() {
+    auto state = Session::load(sessionRoot);
+    if (state.tabs.isEmpty()) {
+        return;
+    }
+    int first = count();
+    for (const auto &tab: state.tabs) {
+        QMutexLocker locker(&tabMutex);
+        addTab(new TabPlaceholder(tab, this), QFileInfo(tab.path).fileName());
+    }
+    recent = state.recent;
+    // only the current tab is built now, by the tab change
+    if (state.current >= 0) {
+        setCurrentIndex(first + state.current);
+    }
+
+    int warm = Configs::instance().get("sessionWarmTabs").toInt();
+    for (const auto &path: recent) {
+        if (warmUpQueue.size() >= warm) {
+            break;
+        }
+        int index = indexOfFile(path);
+        if (index != -1 && qobject_cast<TabPlaceholder *>(widget(index))) {
+            warmUpQueue.append(path);
+        }
+    }
+    if (!warmUpQueue.isEmpty()) {
+        warmUpTimer.start();
+    }
+}
+
+void CodeTabWidget::warmUpNext() {
+    if (warmUpQueue.isEmpty()) {
+        warmUpTimer.stop();
+        return;
+    }
+    int index = indexOfFile(warmUpQueue.takeFirst());
+    if (index != -1) {
+        materialize(index);
+    }
+}
+
+void CodeTabWidget::saveSession() {
+    if (sessionRoot.isEmpty()) {
+        return;
+    }
+    SessionState state;
+    for (int i = 0; i < count(); ++i) {
+        if (auto *edit = editAt(i)) {
+            state.tabs.append(edit->tabState());
+        } else if (auto *placeholder = qobject_cast<TabPlaceholder *>(widget(i))) {
+            state.tabs.append(placeholder->state);
+        } else {
+            continue;
+        }
+        if (i == currentIndex()) {
+            state.current = static_cast<int>(state.tabs.size()) - 1;
+        }
+    }
+    for (const auto &path: recent) {
+        if (indexOfFile(path) != -1) {
+            state.recent.append(path);
+        }
+    }
+    Session::save(sessionRoot, state);
+}
+
+void CodeTabWidget::scheduleSessionSave() { sessionTimer.start(); }
+
+int CodeTabWidget::indexOfFile(const QString &filePath) const {
+    for (int i = 0; i < count(); ++i) {
+        if (auto *edit = editAt(i)) {
+            if (edit->getFile().filePath() == filePath) {
+                return i;
+            }
+        } else if (auto *placeholder = qobject_cast<TabPlaceholder *>(widget(i))) {
+            if (placeholder->state.path == filePath) {
+                return i;
+            }
+        }
+    }
+    return -1;
+}
+
+void CodeTabWidget::restoreJournals() {
+    // reopen the files of the project that have unsaved edits from a crashed run
+    QString root = QDir(project->getRoot()).absolutePath() + "/";
+    for (const auto &path: EditJournal::pending()) {
+        if (path.startsWith(root)) {
+            addCodeEdit(path);
+        }
+    }
 }
 
 void CodeTabWidget::clearAll() {
@@ -670,34 +1302,150 @@ void CodeTabWidget::welcome() { addTab(new WelcomeWidget(this), "欢迎"); }
 
 CodeEditWidget *CodeTabWidget::addCodeEdit(const QString &filePath) {
     // find if the file is already opened
-    for (int i = 0; i < count(); ++i) {
-        auto *edit = editAt(i);
-        if (edit && edit->getFile().filePath() == filePath) {
-            setCurrentIndex(i); // switch to the existing tab
-            return edit;
-        }
+    int existing = indexOfFile(filePath);
+    if (existing != -1) {
+        setCurrentIndex(existing); // switch to the existing tab, which materializes it
+        return materialize(existing);
     }
 
-    auto *edit = new CodeEditWidget(filePath, this);
+    auto *edit = newCodeEdit(filePath);
     int index;
     {
         QMutexLocker locker(&tabMutex);
         index = addTab(edit, edit->getTabText());
     }
-    connect(edit, &CodeEditWidget::modify, this, [this, index] { widgetModified(index); });
-    connect(edit, &CodeEditWidget::jumpTo, this, &CodeTabWidget::jumpTo);
     setCurrentIndex(index);
+    edit->recoverFromJournal();
+    scheduleSessionSave();
     return edit;
 }
 
-void CodeTabWidget::checkRemoveCodeEdit(const QString &filename) {
-    for (int i = 0; i < count(); ++i) {
-        auto *edit = editAt(i);
-        if (edit && edit->getFile().filePath() == filename) {
-            removeCodeEdit(i);
-            return;
+CodeEditWidget *CodeTabWidget::newCodeEdit(const QString &filePath) {
+    auto *edit = new CodeEditWidget(filePath, this);
+    // the tabs move, so always find the index again
+    connect(edit, &CodeEditWidget::modify, this, [this, edit] { widgetModified(indexOf(edit)); });
+    connect(edit, &CodeEditWidget::saved, this, [this, edit] {
+        // recover the tab title
+        QMutexLocker locker(&tabMutex);
+        int i = indexOf(edit);
+        if (i != -1) {
+            setTabText(i, edit->getTabText());
+        }
+    });
+    connect(edit, &CodeEditWidget::jumpTo, this, &CodeTabWidget::jumpTo);
+    connect(edit, &CodeEditWidget::cursorPositionChanged, this,
+            &CodeTabWidget::scheduleSessionSave);
+    if (!watcher.files().contains(filePath)) {
+        watcher.addPath(filePath);
+    }
+    return edit;
+}
+
+void CodeTabWidget::onFileChanged(const QString &path) {
+    changedFiles.insert(path);
+    reloadTimer.start();
+}
+
+void CodeTabWidget::reloadChangedFiles() {
+    for (const auto &path: std::exchange(changedFiles, {})) {
+        auto *edit = editAt(indexOfFile(path));
+        if (!edit) {
+            watcher.removePath(path); // closed or hibernated
+            continue;
+        }
+        // a file replaced by renaming (like our saves) is not watched anymore
+        if (!watcher.files().contains(path) && QFileInfo::exists(path)) {
+            watcher.addPath(path);
+        }
+        edit->reloadFile();
+    }
+}
+
+CodeEditWidget *CodeTabWidget::materialize(int index) {
+    auto *placeholder = qobject_cast<TabPlaceholder *>(widget(index));
+    if (!placeholder) {
+        return editAt(index);
+    }
+    auto *edit = newCodeEdit(placeholder->state.path);
+    bool current = currentIndex() == index;
+    {
+        // swapping the widgets changes the current tab back and forth
+        QScopedValueRollback guard(materializing, true);
+        QMutexLocker locker(&tabMutex);
+        removeTab(index);
+        insertTab(index, edit, edit->getTabText());
+        if (current) {
+            setCurrentIndex(index);
         }
     }
+    if (!placeholder->unsaved.isEmpty()) {
+        edit->restoreUnsaved(QString::fromUtf8(qUncompress(placeholder->unsaved)));
+    }
+    edit->restoreTabState(placeholder->state);
+    placeholder->deleteLater();
+    lastUsed[edit->getFile().filePath()] = QDateTime::currentMSecsSinceEpoch();
+    if (current) {
+        FooterWidget::instance().setFileLabel(edit->getFile().filePath());
+    }
+    // the journal of a hibernated tab is already the unsaved text
+    if (placeholder->unsaved.isEmpty()) {
+        edit->recoverFromJournal();
+    }
+    return edit;
+}
+
+void CodeTabWidget::hibernate(int index) {
+    auto *edit = editAt(index);
+    if (!edit || index == currentIndex()) {
+        return;
+    }
+    auto *placeholder = new TabPlaceholder(edit->tabState(), this);
+    if (edit->isModified()) {
+        placeholder->unsaved = qCompress(edit->snapshot().toUtf8());
+    }
+    {
+        QScopedValueRollback guard(materializing, true);
+        QMutexLocker locker(&tabMutex);
+        QString title = tabText(index);
+        removeTab(index);
+        insertTab(index, placeholder, title);
+    }
+    // drops the document, the syntax tree and the highlights, and closes it in the server
+    edit->deleteLater();
+}
+
+void CodeTabWidget::applyMemoryBudget() {
+    qint64 budget = Configs::instance().get("hibernateBudgetMB").toInteger() * 1024 * 1024;
+    qint64 idle = Configs::instance().get("hibernateIdleMinutes").toInteger() * 60 * 1000;
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    // the most recently used tabs are the ones kept in memory
+    qint64 used = 0;
+    QList<int> victims;
+    for (const auto &path: recent) {
+        int index = indexOfFile(path);
+        auto *edit = editAt(index);
+        if (!edit) {
+            continue;
+        }
+        used += edit->memoryCost();
+        if (index == currentIndex()) {
+            continue;
+        }
+        if ((budget > 0 && used > budget) || (idle > 0 && now - lastUsed.value(path, now) > idle)) {
+            victims.append(index);
+        }
+    }
+    // hibernating swaps the widget in place, so the indexes stay valid
+    for (int index: victims) {
+        hibernate(index);
+    }
+}
+
+void CodeTabWidget::checkRemoveCodeEdit(const QString &filename) {
+    int index = indexOfFile(filename);
+    if (index != -1) {
+        removeCodeEdit(index);
+    }
 }
 
 void CodeTabWidget::handleFileOperation(const QString &filename, FileOperation operation) {
@@ -713,17 +1461,29 @@ void CodeTabWidget::handleFileOperation(const QString &filename, FileOperation o
     }
 }
 
-void CodeTabWidget::removeCodeEditRequested(int index) {
+QCoro::Task<> CodeTabWidget::removeCodeEditRequested(int index) {
     if (index < 0 || index >= count())
-        return;
+        co_return;
 
-    auto *edit = editAt(index);
-    if (!edit || edit->askForSave()) {
+    auto *placeholder = qobject_cast<TabPlaceholder *>(widget(index));
+    if (placeholder && !placeholder->unsaved.isEmpty()) {
+        materialize(index); // a hibernated tab with unsaved edits
+    }
+    QPointer edit = editAt(index);
+    if (!edit) {
         removeCodeEdit(index);
+        co_return;
+    }
+    // the tabs may move while saving, so find it again
+    if (co_await edit->askForSave() && edit) {
+        removeCodeEdit(indexOf(edit));
     }
 }
 
 void CodeTabWidget::widgetModified(int index) {
+    if (!editAt(index)) {
+        return;
+    }
     QMutexLocker locker(&tabMutex);
     // add a * after the title
     setTabText(index, editAt(index)->getTabText() + " *");
@@ -736,6 +1496,7 @@ void CodeTabWidget::removeCodeEdit(int index) {
     QWidget *w = widget(index);
     removeTab(index);
     w->deleteLater();
+    scheduleSessionSave();
 
     if (count() == 0) {
         welcome();
@@ -750,18 +1511,55 @@ LangFileInfo CodeTabWidget::currentFile() const {
     return LangFileInfo::empty();
 }
 
-void CodeTabWidget::save() {
+QCoro::Task<bool> CodeTabWidget::save() {
     if (auto *edit = curEdit()) {
-        edit->saveFile();
-        // recover the tab title
-        QMutexLocker locker(&tabMutex);
-        setTabText(currentIndex(), edit->getTabText());
+        co_return co_await edit->saveFile();
+    }
+    co_return true;
+}
+
+QCoro::Task<bool> CodeTabWidget::saveAll() {
+    // start all the saves first, so they are written concurrently
+    std::vector<QCoro::Task<bool>> saves;
+    for (int i = 0; i < count(); ++i) {
+        auto *placeholder = qobject_cast<TabPlaceholder *>(widget(i));
+        if (placeholder && !placeholder->unsaved.isEmpty()) {
+            materialize(i); // a hibernated tab with unsaved edits
+        }
+        auto *edit = editAt(i);
+        if (edit && edit->isModified()) {
+            saves.push_back(edit->saveFile());
+        }
+    }
+    bool ok = true;
+    for (auto &task: saves) {
+        ok = co_await task && ok;
     }
+    co_return ok;
 }
 
-void CodeTabWidget::onCurrentTabChanged(int) const {
+void CodeTabWidget::showFindBar(bool replace) {
+    if (auto *edit = curEdit()) {
+        edit->showFindBar(replace);
+    }
+}
+
+void CodeTabWidget::onCurrentTabChanged(int index) {
+    if (materializing) {
+        return;
+    }
+    if (qobject_cast<TabPlaceholder *>(widget(index))) {
+        materialize(index);
+    }
     const auto *edit = curEdit();
+    if (edit) {
+        recent.removeAll(edit->getFile().filePath());
+        recent.prepend(edit->getFile().filePath());
+        lastUsed[edit->getFile().filePath()] = QDateTime::currentMSecsSinceEpoch();
+    }
     FooterWidget::instance().setFileLabel(edit ? edit->getFile().filePath() : "");
+    scheduleSessionSave();
+    applyMemoryBudget();
 }
 
 void CodeTabWidget::jumpTo(const QUrl &url, int startLine, int startChar, int endLine,
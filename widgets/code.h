@@ -1,14 +1,23 @@
 #ifndef CODE_EDIT_H
 #define CODE_EDIT_H
 
+#include <QFileSystemWatcher>
 #include <QListWidget>
 #include <QPlainTextEdit>
+#include <QTimer>
+#include <optional>
 #include <qcorotask.h>
 
+#include "../ide/buffer.h"
 #include "../ide/highlighter.h"
+#include "../ide/journal.h"
 #include "../ide/lsp.h"
 #include "../ide/project.h"
+#include "../ide/search.h"
+#include "../ide/session.h"
+#include "../util/latency.h"
 #include "fileTree.h"
+#include "find.h"
 
 class CodeEditWidget;
 
@@ -60,6 +69,18 @@ public:
     explicit WelcomeWidget(QWidget *parent);
 };
 
+/** Stands for a restored or hibernated tab, until the tab is shown or warmed up */
+class TabPlaceholder : public QWidget {
+    Q_OBJECT
+
+public:
+    const TabState state;
+    /** The compressed unsaved text of a hibernated tab, empty to read the file */
+    QByteArray unsaved;
+
+    explicit TabPlaceholder(TabState state, QWidget *parent);
+};
+
 class CodeEditWidget : public QPlainTextEdit {
     Q_OBJECT
 
@@ -67,6 +88,8 @@ class CodeEditWidget : public QPlainTextEdit {
     friend class CompletionList;
 
     LangFileInfo file;
+    TextBuffer *buffer;
+    EditJournal *journal;
     Highlighter *highlighter;
     LanguageServer *server;
     CompletionList *cl;
@@ -74,22 +97,54 @@ class CodeEditWidget : public QPlainTextEdit {
 
     bool modified;
     bool requireCompletion;
+    /** The content of the file on the disk, as last read or saved */
+    TextSnapshot diskContent;
+    /** The content being written by saveFile, the watcher may see it before the save returns */
+    std::optional<TextSnapshot> saving;
+
+    /** Shows the keystroke latency when the latencyOverlay config is on */
+    QLabel *latencyLabel;
+    FindBarWidget *findBar;
+    TextSearch *search;
+    /** Matches of the find bar, sorted by offset */
+    QList<TextMatch> matches;
+    bool searchDone;
+    /** Select the first match found, when the user is typing the query */
+    bool jumpToMatch;
+    QString lastReplacement;
+    QTimer researchTimer;
 
     void setup();
+    /** Paint the matches in the visible blocks only */
+    void paintMatches(QPainter &painter, const QRect &area);
+    void selectMatch(const TextMatch &match);
+    /** Index of the match selected by the cursor, -1 if none */
+    int currentMatch() const;
+    void updateMatchCount();
+    /** Keep the find bar at the top right and the latency overlay at the bottom right */
+    void placeOverlays();
+    /** Keep the matches in place while the text is edited */
+    void shiftMatches(const TextChange &change);
+    /** Send the changes to the language server */
+    void syncServer(const TextChanges &changes);
 
 private slots:
     /** Async initialization */
     QCoro::Task<> onSetupFinished();
     /** Font setter for configs */
     void onSetFont(const QJsonValue &value);
+    void onSetLatencyOverlay(const bool &enabled);
+    void showLatency(const LatencySample &sample);
     /** Adapt the viewport margins */
     void adaptViewport();
     /** Update the line number area when the content changes */
     void updateLineNumberArea(const QRect &rect, int dy);
     /** Highlight the line where the cursor is */
     void highlightLine();
-    /** What to do when the text is modified */
-    QCoro::Task<> onTextChanged();
+    /** What to do when the text is modified, once for all the edits in a frame */
+    void onTextChanged(const TextChanges &changes);
+    /** Complete the word under the cursor after an edit */
+    QCoro::Task<> completeAfterEdit();
     /** Update the cursor position (and tell it to highlighter) */
     void updateCursorPosition() const;
     /** Ask the language server for completion */
@@ -102,32 +157,64 @@ private slots:
     void onToggleComment();
     /** Ask the language server for definition */
     QCoro::Task<> askForDefinition();
+    /** Start searching with the query in the find bar */
+    void onQueryChanged(const SearchQuery &query);
+    void onMatchesFound(const QList<TextMatch> &found);
+    void onSearchFinished(int count);
+    void findNext();
+    void findPrevious();
+    void replaceOne(const QString &replacement);
+    void replaceAll(const QString &replacement);
+    void onReplaceReady(const TextSnapshot &source, qsizetype from, qsizetype to,
+                        const QString &text, int count);
+    void onFindBarClosed();
 
 signals:
     void setupFinished();
     void modify();
+    void saved();
     void toggleComment();
     void jumpToDefinition();
     void jumpTo(QUrl url, int startLine, int startChar, int endLine, int endChar);
 
 protected:
     void resizeEvent(QResizeEvent *event) override;
+    void paintEvent(QPaintEvent *event) override;
     void keyPressEvent(QKeyEvent *e) override;
     void mousePressEvent(QMouseEvent *event) override;
 
 public:
     explicit CodeEditWidget(const QString &filename, QWidget *parent = nullptr);
+    ~CodeEditWidget() override;
 
     const LangFileInfo &getFile() const;
+    /** An immutable copy of the current content, cheap to take */
+    TextSnapshot snapshot() const;
     QString getTabText() const;
     /** Read the file content and display it */
     void readFile();
-    /** Save the file content to the file */
-    void saveFile();
-    /** Check if the content is modified, if so, ask for save */
-    bool askForSave();
+    /** Ask the user to restore the unsaved content left by a crash, if there is any */
+    void recoverFromJournal();
+    /** Load the file again when it is changed by another program, asking if it is modified */
+    void reloadFile();
+    /** Replace [from, to) by text in one undo step, only editing the lines that differ */
+    void replaceText(qsizetype from, qsizetype to, const QString &text);
+    bool isModified() const;
+    /** Save the file content to the file on a worker thread, return if succeeded */
+    QCoro::Task<bool> saveFile();
+    /** Check if the content is modified, if so, ask for save. Return false if canceled */
+    QCoro::Task<bool> askForSave();
     /** Move the cursor to the given position */
     void cursorMoveTo(int startLine, int startChar, int endLine, int endChar);
+    /** Show the find bar, with the replace row if required */
+    void showFindBar(bool replace);
+    /** The file, cursor and scroll position to restore the tab next time */
+    TabState tabState() const;
+    void restoreTabState(const TabState &state);
+    /** Put back the unsaved text of a hibernated tab, on top of the file content */
+    void restoreUnsaved(const QString &text);
+    /** A rough estimate of the memory held by the editor, in bytes */
+    qint64 memoryCost() const;
 };
 
 class CodeTabWidget : public QTabWidget {
@@ -135,12 +222,42 @@ class CodeTabWidget : public QTabWidget {
 
     Project *project = nullptr;
     QMutex tabMutex;
+    /** Root of the project whose tabs are shown, the project object is shared */
+    QString sessionRoot;
+    /** Paths of the opened files, the most recently used first */
+    QStringList recent;
+    QTimer sessionTimer;
+    /** Placeholders are materialized one by one, to keep the window responsive */
+    QTimer warmUpTimer;
+    QStringList warmUpQueue;
+    bool materializing = false;
+    /** When the tabs were last shown, in ms since epoch */
+    QHash<QString, qint64> lastUsed;
+    QTimer hibernateTimer;
+    /** Watch the opened files, to reload the ones changed by other programs */
+    QFileSystemWatcher watcher;
+    QSet<QString> changedFiles;
+    QTimer reloadTimer;
 
     void setup();
     /** Add a welcome widget */
     void welcome();
     /** Add a code edit widget for the given file */
     CodeEditWidget *addCodeEdit(const QString &filePath);
+    /** Create a code edit widget and connect it to the tabs */
+    CodeEditWidget *newCodeEdit(const QString &filePath);
+    /** Replace the placeholder at the index by a code edit */
+    CodeEditWidget *materialize(int index);
+    /** Replace the background code edit at the index by a placeholder keeping only its text */
+    void hibernate(int index);
+    /** Index of the tab (code edit or placeholder) of the file, -1 if not opened */
+    int indexOfFile(const QString &filePath) const;
+    /** Reopen the tabs of the last session as placeholders */
+    void restoreSession();
+    void saveSession();
+    void scheduleSessionSave();
+    /** Open the files with unsaved edits left by a crash */
+    void restoreJournals();
     /** Check if the file is opened, if so, remove it */
     void checkRemoveCodeEdit(const QString &filename);
 
@@ -150,11 +267,18 @@ public slots:
     /** Remove the code edit widget at the given index */
     void removeCodeEdit(int index);
     /** Ask the user before removing the code edit widget */
-    void removeCodeEditRequested(int index);
+    QCoro::Task<> removeCodeEditRequested(int index);
     /** What to do when a widget is modified */
     void widgetModified(int index);
     /** What to do when the current tab changed */
-    void onCurrentTabChanged(int index) const;
+    void onCurrentTabChanged(int index);
+    /** Materialize the next recently used tab */
+    void warmUpNext();
+    /** Hibernate the background tabs beyond the memory budget or idle for too long */
+    void applyMemoryBudget();
+    void onFileChanged(const QString &path);
+    /** Reload the files changed since the last time, once they are quiet */
+    void reloadChangedFiles();
     /** Jump to the given range */
     void jumpTo(const QUrl &url, int startLine, int startChar, int endLine, int endChar);
 
@@ -165,7 +289,12 @@ public:
     LangFileInfo currentFile() const;
     CodeEditWidget *curEdit() const;
     CodeEditWidget *editAt(int index) const;
-    void save();
+    /** Save the current file, return if succeeded */
+    QCoro::Task<bool> save();
+    /** Save every modified file at once, return if all succeeded */
+    QCoro::Task<bool> saveAll();
+    /** Find (or replace) in the current file */
+    void showFindBar(bool replace);
 };
 
 #endif // CODE_EDIT_H
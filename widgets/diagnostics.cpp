@@ -0,0 +1,68 @@
+#include "diagnostics.h"
+
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QPushButton>
+#include <QVBoxLayout>
+
+#include "../util/file.h"
+
+DiagnosticsDialog::DiagnosticsDialog(QWidget *parent) : QDialog(parent) {
+    setWindowTitle(tr("界面卡顿记录"));
+    summaryLabel = new QLabel(this);
+    stallTable = new QTableWidget(0, 3, this);
+    setup();
+
+    for (const auto &stall: Watchdog::instance().recentStalls()) {
+        onStallRecorded(stall);
+    }
+    connect(&Watchdog::instance(), &Watchdog::stallRecorded, this,
+            &DiagnosticsDialog::onStallRecorded);
+}
+
+void DiagnosticsDialog::setup() {
+    stallTable->setHorizontalHeaderLabels({tr("时间"), tr("时长 (ms)"), tr("任务")});
+    stallTable->horizontalHeader()->setStretchLastSection(true);
+    stallTable->verticalHeader()->hide();
+    stallTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    stallTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+
+    auto *clearBtn = new QPushButton(tr("清空"), this);
+    auto *closeBtn = new QPushButton(tr("关闭"), this);
+    connect(clearBtn, &QPushButton::clicked, this, &DiagnosticsDialog::onClear);
+    connect(closeBtn, &QPushButton::clicked, this, &QDialog::accept);
+
+    auto *btnLayout = new QHBoxLayout();
+    btnLayout->addStretch();
+    btnLayout->addWidget(clearBtn);
+    btnLayout->addWidget(closeBtn);
+
+    auto *mainLayout = new QVBoxLayout(this);
+    mainLayout->addWidget(summaryLabel);
+    mainLayout->addWidget(stallTable);
+    mainLayout->addLayout(btnLayout);
+    setLayout(mainLayout);
+    resize(640, 400);
+    updateSummary();
+}
+
+void DiagnosticsDialog::updateSummary() {
+    summaryLabel->setText(tr("阈值 %1 ms，共 %2 次卡顿")
+                                  .arg(Configs::instance().get("stallThresholdMs").toInt())
+                                  .arg(stallTable->rowCount()));
+}
+
+void DiagnosticsDialog::onStallRecorded(const Stall &stall) {
+    stallTable->insertRow(0);
+    stallTable->setItem(0, 0, new QTableWidgetItem(stall.start.toString("HH:mm:ss.zzz")));
+    stallTable->setItem(0, 1, new QTableWidgetItem(QString::number(stall.duration)));
+    stallTable->setItem(0, 2,
+                        new QTableWidgetItem(stall.task.isEmpty() ? tr("未知") : stall.task));
+    updateSummary();
+}
+
+void DiagnosticsDialog::onClear() {
+    Watchdog::instance().clearStalls();
+    stallTable->setRowCount(0);
+    updateSummary();
+}
@@ -0,0 +1,28 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <QDialog>
+#include <QLabel>
+#include <QTableWidget>
+
+#include "../util/watchdog.h"
+
+/** The stalls of the GUI thread noticed by the watchdog, newest first */
+class DiagnosticsDialog : public QDialog {
+    Q_OBJECT
+
+    QLabel *summaryLabel;
+    QTableWidget *stallTable;
+
+    void setup();
+    void updateSummary();
+
+private slots:
+    void onStallRecorded(const Stall &stall);
+    void onClear();
+
+public:
+    explicit DiagnosticsDialog(QWidget *parent = nullptr);
+};
+
+#endif // DIAGNOSTICS_H
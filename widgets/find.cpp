@@ -0,0 +1,112 @@
+#include "find.h"
+
+#include <QGridLayout>
+#include <QGuiApplication>
+#include <QKeyEvent>
+
+FindBarWidget::FindBarWidget(QWidget *parent) : QFrame(parent) {
+    findEdit = new QLineEdit(this);
+    replaceEdit = new QLineEdit(this);
+    regexBox = new QCheckBox(tr("正则"), this);
+    caseBox = new QCheckBox(tr("区分大小写"), this);
+    countLabel = new QLabel(this);
+    replaceBtn = new QPushButton(tr("替换"), this);
+    replaceAllBtn = new QPushButton(tr("全部替换"), this);
+    setup();
+}
+
+void FindBarWidget::setup() {
+    auto *layout = new QGridLayout(this);
+    layout->setContentsMargins(6, 6, 6, 6);
+    layout->setSpacing(4);
+
+    findEdit->setPlaceholderText(tr("查找"));
+    replaceEdit->setPlaceholderText(tr("替换"));
+    countLabel->setMinimumWidth(70);
+
+    auto *prevBtn = new QPushButton("↑", this);
+    auto *nextBtn = new QPushButton("↓", this);
+    auto *closeBtn = new QPushButton("×", this);
+    prevBtn->setToolTip(tr("上一个 (Shift+Enter)"));
+    nextBtn->setToolTip(tr("下一个 (Enter)"));
+
+    layout->addWidget(findEdit, 0, 0);
+    layout->addWidget(countLabel, 0, 1);
+    layout->addWidget(prevBtn, 0, 2);
+    layout->addWidget(nextBtn, 0, 3);
+    layout->addWidget(closeBtn, 0, 4);
+    layout->addWidget(replaceEdit, 1, 0);
+    layout->addWidget(replaceBtn, 1, 1);
+    layout->addWidget(replaceAllBtn, 1, 2, 1, 3);
+    layout->addWidget(regexBox, 2, 0);
+    layout->addWidget(caseBox, 2, 1, 1, 4);
+    setLayout(layout);
+
+    connect(findEdit, &QLineEdit::textChanged, this, &FindBarWidget::onQueryEdited);
+    connect(regexBox, &QCheckBox::toggled, this, &FindBarWidget::onQueryEdited);
+    connect(caseBox, &QCheckBox::toggled, this, &FindBarWidget::onQueryEdited);
+    connect(findEdit, &QLineEdit::returnPressed, this, [this] {
+        if (QGuiApplication::keyboardModifiers() & Qt::ShiftModifier) {
+            emit findPrevious();
+        } else {
+            emit findNext();
+        }
+    });
+    connect(replaceEdit, &QLineEdit::returnPressed, this,
+            [this] { emit replaceOne(replaceEdit->text()); });
+    connect(prevBtn, &QPushButton::clicked, this, &FindBarWidget::findPrevious);
+    connect(nextBtn, &QPushButton::clicked, this, &FindBarWidget::findNext);
+    connect(replaceBtn, &QPushButton::clicked, this,
+            [this] { emit replaceOne(replaceEdit->text()); });
+    connect(replaceAllBtn, &QPushButton::clicked, this,
+            [this] { emit replaceAll(replaceEdit->text()); });
+    connect(closeBtn, &QPushButton::clicked, this, [this] {
+        hide();
+        emit closed();
+    });
+}
+
+SearchQuery FindBarWidget::query() const {
+    return {findEdit->text(), regexBox->isChecked(), caseBox->isChecked()};
+}
+
+void FindBarWidget::onQueryEdited() {
+    auto q = query();
+    if (q.regex && !q.isEmpty() && !q.expression().isValid()) {
+        countLabel->setText(tr("正则错误"));
+        countLabel->setToolTip(q.expression().errorString());
+        return;
+    }
+    countLabel->setToolTip("");
+    emit queryChanged(q);
+}
+
+void FindBarWidget::activate(const QString &text, bool replace) {
+    replaceEdit->setVisible(replace);
+    replaceBtn->setVisible(replace);
+    replaceAllBtn->setVisible(replace);
+    adjustSize();
+    show();
+    raise();
+    if (!text.isEmpty() && text != findEdit->text()) {
+        findEdit->setText(text); // emits queryChanged
+    } else {
+        onQueryEdited();
+    }
+    findEdit->setFocus();
+    findEdit->selectAll();
+}
+
+void FindBarWidget::setCount(int current, int total, bool finished) {
+    QString text = current > 0 ? QString("%1/%2").arg(current).arg(total) : QString::number(total);
+    countLabel->setText(finished ? text : text + "+");
+}
+
+void FindBarWidget::keyPressEvent(QKeyEvent *e) {
+    if (e->key() == Qt::Key_Escape) {
+        hide();
+        emit closed();
+        return;
+    }
+    QFrame::keyPressEvent(e);
+}
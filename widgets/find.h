@@ -0,0 +1,49 @@
+#ifndef FIND_H
+#define FIND_H
+
+#include <QCheckBox>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
+
+#include "../ide/search.h"
+
+/** The find/replace bar floating at the top right of a code edit */
+class FindBarWidget : public QFrame {
+    Q_OBJECT
+
+    QLineEdit *findEdit;
+    QLineEdit *replaceEdit;
+    QCheckBox *regexBox;
+    QCheckBox *caseBox;
+    QLabel *countLabel;
+    QPushButton *replaceBtn;
+    QPushButton *replaceAllBtn;
+
+    void setup();
+
+private slots:
+    void onQueryEdited();
+
+signals:
+    void queryChanged(const SearchQuery &query);
+    void findNext();
+    void findPrevious();
+    void replaceOne(const QString &replacement);
+    void replaceAll(const QString &replacement);
+    void closed();
+
+protected:
+    void keyPressEvent(QKeyEvent *e) override;
+
+public:
+    explicit FindBarWidget(QWidget *parent);
+
+    SearchQuery query() const;
+    /** Show the bar with the given text to find, and the replace row if required */
+    void activate(const QString &text, bool replace);
+    /** current is 0 when the cursor is not at a match */
+    void setCount(int current, int total, bool finished);
+};
+
+#endif // FIND_H
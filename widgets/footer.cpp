@@ -1,31 +1,70 @@
 #include "footer.h"
 
+#include <QHeaderView>
 #include <QLabel>
+#include <QPushButton>
+#include <QStyle>
+#include <QVBoxLayout>
 #include <qboxlayout.h>
-#include <utility>
 
 #include "../util/file.h"
+#include "../util/task.h"
 
-#define TASK_FREE (-1)
+#define NOTICE_DURATION 15000 // ms
 
-ProgressBarTask::ProgressBarTask(QString text, int max) : text(std::move(text)), max(max) {
-    static int id = 0;
-    this->id = ++id;
-}
+TaskListPopup::TaskListPopup(QWidget *parent) : QFrame(parent, Qt::Popup) {
+    taskTree = new QTreeWidget(this);
+    taskTree->setColumnCount(4);
+    taskTree->setHeaderLabels({tr("任务"), tr("进度"), tr("状态"), ""});
+    taskTree->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    taskTree->setRootIsDecorated(false);
+    taskTree->setUniformRowHeights(true);
 
-void ProgressBarTask::wait(const QString &newText) const { FooterWidget::instance().waitTask(*this, newText); }
+    auto *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(taskTree);
+    setLayout(layout);
+    resize(480, 240);
 
-void ProgressBarTask::update(int value, const QString &newText) const {
-    FooterWidget::instance().updateTask(*this, value, newText);
+    connect(&TaskManager::instance(), &TaskManager::tasksChanged, this, &TaskListPopup::refresh);
 }
 
-void ProgressBarTask::finish() const { FooterWidget::instance().finishTask(*this); }
+void TaskListPopup::refresh() {
+    if (!isVisible()) {
+        return;
+    }
+    taskTree->clear();
+    for (const auto &task: TaskManager::instance().currentTasks()) {
+        QString progress = task.max > 0 ? QString("%1/%2").arg(task.value).arg(task.max) : "";
+        QString state = task.running
+                                ? tr("运行中")
+                                : tr("等待%1").arg(TaskManager::resourceName(task.resource));
+        auto *item = new QTreeWidgetItem(
+                taskTree, {task.text.isEmpty() ? task.title : task.text, progress, state});
+        item->setToolTip(0, task.title);
+
+        auto *cancelBtn = new QPushButton(tr("取消"), taskTree);
+        // queued, the list is rebuilt when the task is canceled, the button included
+        connect(
+                cancelBtn, &QPushButton::clicked, this,
+                [id = task.id] { TaskManager::instance().cancel(id); }, Qt::QueuedConnection);
+        taskTree->setItemWidget(item, 3, cancelBtn);
+    }
+}
 
-FooterWidget::FooterWidget(QWidget *parent) : QFrame(parent), curTaskId(TASK_FREE) {
+FooterWidget::FooterWidget(QWidget *parent) : QFrame(parent) {
     fileLabel = new QLabel(this);
     progressBar = new QProgressBar(this);
     reminderLabel = new QLabel(this);
+    noticeLabel = new QLabel(this);
+    taskBtn = new QToolButton(this);
+    taskPopup = new TaskListPopup(this);
     setup();
+
+    connect(&TaskManager::instance(), &TaskManager::tasksChanged, this,
+            &FooterWidget::onTasksChanged);
+    connect(taskBtn, &QToolButton::clicked, this, &FooterWidget::showTaskList);
+    connect(&noticeTimer, &QTimer::timeout, noticeLabel, &QLabel::hide);
 }
 
 void FooterWidget::setup() {
@@ -36,14 +75,24 @@ void FooterWidget::setup() {
     fileLabel->setStyleSheet("color: #999999");
 
     reminderLabel->setText("");
+    noticeLabel->setObjectName("noticeLabel");
+    noticeLabel->setVisible(false);
+    noticeTimer.setSingleShot(true);
+    noticeTimer.setInterval(NOTICE_DURATION);
     progressBar->setMaximumWidth(250);
     progressBar->setMinimumWidth(150);
     progressBar->setVisible(false);
+    taskBtn->setObjectName("taskBtn");
+    taskBtn->setArrowType(Qt::UpArrow);
+    taskBtn->setToolTip(tr("后台任务"));
+    taskBtn->setVisible(false);
 
     layout->addWidget(fileLabel);
     layout->addStretch(1);
+    layout->addWidget(noticeLabel);
     layout->addWidget(reminderLabel);
     layout->addWidget(progressBar);
+    layout->addWidget(taskBtn);
 
     setLayout(layout);
 
@@ -59,28 +108,61 @@ void FooterWidget::clear() const { fileLabel->setText(""); }
 
 void FooterWidget::setFileLabel(const QString &text) const { fileLabel->setText(text); }
 
-ProgressBarTask FooterWidget::newTask(const QString &text, int max) { return ProgressBarTask(text, max); }
-
-void FooterWidget::waitTask(const ProgressBarTask &task, const QString &newText) { updateTask(task, 0, newText); }
-
-void FooterWidget::updateTask(const ProgressBarTask &task, int value, const QString &newText) {
-    if (curTaskId == TASK_FREE || curTaskId == task.id) {
-        // accept the update
-        reminderLabel->setText(newText == nullptr ? task.text : newText);
-        progressBar->setVisible(true);
-        progressBar->setMaximum(task.max);
-        progressBar->setValue(value);
-        curTaskId = task.id;
-    }
-    // else we ignore the update request
+void FooterWidget::notify(const QString &text, bool ok, const QString &detail) {
+    noticeLabel->setText(text);
+    noticeLabel->setToolTip(detail);
+    // the color comes from the ok property in footer.css
+    noticeLabel->setProperty("ok", ok);
+    noticeLabel->style()->unpolish(noticeLabel);
+    noticeLabel->style()->polish(noticeLabel);
+    noticeLabel->setVisible(true);
+    noticeTimer.start();
 }
 
-void FooterWidget::finishTask(const ProgressBarTask &task) {
-    if (curTaskId == task.id) {
+void FooterWidget::onTasksChanged() {
+    auto tasks = TaskManager::instance().currentTasks();
+    taskBtn->setVisible(!tasks.isEmpty());
+    if (tasks.isEmpty()) {
         progressBar->setVisible(false);
-        curTaskId = TASK_FREE;
         reminderLabel->setText("");
+        taskPopup->hide();
+        return;
+    }
+
+    // the running task of the highest priority speaks for all of them
+    const TaskInfo *shown = nullptr;
+    int value = 0, max = 0;
+    bool unknown = false;
+    for (const auto &task: tasks) {
+        if (!task.running) {
+            continue;
+        }
+        if (!shown || task.priority > shown->priority) {
+            shown = &task;
+        }
+        value += task.value;
+        max += task.max;
+        unknown |= task.max == 0;
     }
+    if (!shown) {
+        shown = &tasks.first(); // all queued
+        unknown = true;
+    }
+    QString text = shown->text.isEmpty() ? shown->title : shown->text;
+    if (tasks.size() > 1) {
+        text += tr("（共 %1 个任务）").arg(tasks.size());
+    }
+    reminderLabel->setText(text);
+    progressBar->setVisible(true);
+    // a task without a known progress makes the whole bar busy
+    progressBar->setMaximum(unknown ? 0 : max);
+    progressBar->setValue(unknown ? 0 : value);
+}
 
-    // TODO: Keep a queue here for other tasks
+void FooterWidget::showTaskList() {
+    // open upwards from the right edge of the footer
+    QPoint bottomRight = mapToGlobal(QPoint(width(), 0));
+    taskPopup->move(bottomRight.x() - taskPopup->width(), bottomRight.y() - taskPopup->height());
+    taskPopup->show();
+    taskPopup->refresh();
 }
@@ -3,21 +3,21 @@
 
 #include <QLabel>
 #include <QProgressBar>
+#include <QTimer>
+#include <QToolButton>
+#include <QTreeWidget>
 
-class FooterWidget;
+/** The tasks of the task manager, with a button to cancel each one */
+class TaskListPopup : public QFrame {
+    Q_OBJECT
 
-class ProgressBarTask {
-    friend class FooterWidget;
+    QTreeWidget *taskTree;
 
-    unsigned int id;
-    QString text;
-    int max;
+public slots:
+    void refresh();
 
-    explicit ProgressBarTask(QString text, int max);
 public:
-    void wait(const QString &newText = nullptr) const;
-    void update(int value, const QString &newText = nullptr) const;
-    void finish() const;
+    explicit TaskListPopup(QWidget *parent = nullptr);
 };
 
 class FooterWidget : public QFrame {
@@ -25,26 +25,27 @@ class FooterWidget : public QFrame {
 
     QLabel *fileLabel;
     QLabel *reminderLabel;
+    QLabel *noticeLabel;
+    QTimer noticeTimer;
     QProgressBar *progressBar;
-    int curTaskId; // set -1 to be no task
+    QToolButton *taskBtn;
+    TaskListPopup *taskPopup;
 
     void setup();
     explicit FooterWidget(QWidget *parent = nullptr);
 
+private slots:
+    /** Show the most important running task, and the progress of all of them */
+    void onTasksChanged();
+    void showTaskList();
+
 public:
     // Use singleton for global access
     static FooterWidget &instance();
     void clear() const;
     void setFileLabel(const QString &text) const;
-
-    /** Generate a new task. */
-    static ProgressBarTask newTask(const QString &text = "", int max = 0);
-    /** Wait for a busy progressBar */
-    void waitTask(const ProgressBarTask &task, const QString &newText = nullptr);
-    /** Update the progress bar with the current task. Here newText is optional */
-    void updateTask(const ProgressBarTask &task, int value, const QString &newText = nullptr);
-    /** Finish the current task. */
-    void finishTask(const ProgressBarTask &task);
+    /** Show a message for a while without interrupting, the detail shows on hover */
+    void notify(const QString &text, bool ok, const QString &detail = {});
 };
 
 #endif // FOOTER_H
@@ -59,6 +59,8 @@ void LeftIconNavigateWidget::addIcons() {
     auto *fileTreeBtn = newIcon("folder", tr("文件树"));
     fileTreeBtn->setChecked(true);
     connect(fileTreeBtn, &QPushButton::toggled, this, &LeftIconNavigateWidget::onToggleFileTree);
+    auto *searchBtn = newIcon("search", tr("在项目中搜索"));
+    connect(searchBtn, &QPushButton::toggled, this, &LeftIconNavigateWidget::onToggleSearch);
 
     layout->addStretch();
 
@@ -68,6 +70,8 @@ void LeftIconNavigateWidget::addIcons() {
 
 void LeftIconNavigateWidget::onToggleFileTree(const bool checked) { emit toggleFileTree(checked); }
 
+void LeftIconNavigateWidget::onToggleSearch(const bool checked) { emit toggleSearch(checked); }
+
 void LeftIconNavigateWidget::onToggleTerminal(const bool checked) { emit toggleTerminal(checked); }
 
 RightIconNavigateWidget::RightIconNavigateWidget(QWidget *parent) : IconNavigateWidget(parent) {
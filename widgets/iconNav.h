@@ -27,6 +27,7 @@ class LeftIconNavigateWidget : public IconNavigateWidget {
 
 private slots:
     void onToggleFileTree(bool checked);
+    void onToggleSearch(bool checked);
     void onToggleTerminal(bool checked);
 
 public:
@@ -34,6 +35,7 @@ public:
 
 signals:
     void toggleFileTree(bool show);
+    void toggleSearch(bool show);
     void toggleTerminal(bool show);
 };
 
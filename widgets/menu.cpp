@@ -10,6 +10,7 @@
 #include <QVBoxLayout>
 
 #include "../util/file.h"
+#include "../web/cache.h"
 
 MenuBarWidget::MenuBarWidget(QWidget *parent) : QMenuBar(parent) {
     user = new QLabel(tr("未登录"), this);
@@ -28,6 +29,8 @@ void MenuBarWidget::setup() {
     // File menu
     QMenu *fileMenu = this->addMenu("文件");
     newAction(fileMenu, tr("保存"), QKeySequence(Qt::CTRL | Qt::Key_S), &MenuBarWidget::onSave);
+    newAction(fileMenu, tr("全部保存"), QKeySequence(Qt::CTRL | Qt::SHIFT | Qt::Key_S),
+              &MenuBarWidget::onSaveAll);
     newAction(fileMenu, tr("打开项目"), QKeySequence(Qt::CTRL | Qt::Key_O),
               &MenuBarWidget::onOpenFolder);
     QMenu *newMenu = fileMenu->addMenu(tr("新建"));
@@ -41,6 +44,10 @@ void MenuBarWidget::setup() {
 
     // Edit menu
     QMenu *editMenu = this->addMenu(tr("编辑"));
+    newAction(editMenu, tr("查找"), QKeySequence(Qt::CTRL | Qt::Key_F), &MenuBarWidget::findText);
+    newAction(editMenu, tr("替换"), QKeySequence(Qt::CTRL | Qt::Key_H),
+              &MenuBarWidget::replaceText);
+    editMenu->addSeparator();
     newAction(editMenu, tr("设置"), QKeySequence(Qt::Key_F5), &MenuBarWidget::onOpenSettings);
 
     // OJ menu
@@ -51,6 +58,23 @@ void MenuBarWidget::setup() {
     newAction(ojMenu, tr("下载"), QKeySequence(), &MenuBarWidget::onDownloadOJ);
     newAction(ojMenu, tr("批量下载"), QKeySequence(), &MenuBarWidget::onBatchDownloadOJ);
     newAction(ojMenu, tr("提交"), QKeySequence(), &MenuBarWidget::onSubmitOJ);
+    ojMenu->addSeparator();
+    newAction(ojMenu, tr("开启/关闭离线模式"), QKeySequence(), &MenuBarWidget::onToggleOffline);
+    newAction(ojMenu, tr("清除页面缓存"), QKeySequence(), &MenuBarWidget::onClearCache);
+
+    // Diagnostics menu
+    QMenu *diagnosticsMenu = this->addMenu(tr("诊断"));
+    newAction(diagnosticsMenu, tr("显示/隐藏输入延迟"), QKeySequence(),
+              &MenuBarWidget::onToggleLatencyOverlay);
+    newAction(diagnosticsMenu, tr("导出输入延迟..."), QKeySequence(),
+              &MenuBarWidget::onExportLatency);
+    newAction(diagnosticsMenu, tr("界面卡顿记录"), QKeySequence(), &MenuBarWidget::showStalls);
+    diagnosticsMenu->addSeparator();
+    newAction(diagnosticsMenu, tr("开始/停止追踪"), QKeySequence(),
+              &MenuBarWidget::onToggleTracing);
+    newAction(diagnosticsMenu, tr("导出追踪..."), QKeySequence(), &MenuBarWidget::onExportTrace);
+    newAction(diagnosticsMenu, tr("导出运行指标..."), QKeySequence(),
+              &MenuBarWidget::onExportMetrics);
 
     // show username here
     right = new QWidget(this);
@@ -73,6 +97,8 @@ void MenuBarWidget::setup() {
 
 void MenuBarWidget::onSave() { emit saveFile(); }
 
+void MenuBarWidget::onSaveAll() { emit saveAllFiles(); }
+
 void MenuBarWidget::onOpenFolder() {
     QString folderPath = QFileDialog::getExistingDirectory(this, tr("选择项目"), QDir::homePath(),
                                                            QFileDialog::ShowDirsOnly);
@@ -83,6 +109,47 @@ void MenuBarWidget::onOpenFolder() {
 
 void MenuBarWidget::onNewFile() { emit newFile(); }
 
+void MenuBarWidget::onToggleLatencyOverlay() {
+    // the editors follow the config
+    Configs::instance().set("latencyOverlay", !Configs::instance().get("latencyOverlay").toBool());
+}
+
+void MenuBarWidget::onExportLatency() {
+    QString path = QFileDialog::getSaveFileName(this, tr("导出输入延迟"),
+                                                QDir::homePath() + "/latency.txt");
+    if (!path.isEmpty()) {
+        emit exportLatency(path);
+    }
+}
+
+void MenuBarWidget::onToggleOffline() {
+    // the pages fetched before stay readable, nothing new is fetched
+    Configs::instance().set("offline", !Configs::instance().get("offline").toBool());
+}
+
+void MenuBarWidget::onClearCache() { PageCache::instance().clear(); }
+
+void MenuBarWidget::onToggleTracing() {
+    // starting again drops the last recording
+    Configs::instance().set("tracing", !Configs::instance().get("tracing").toBool());
+}
+
+void MenuBarWidget::onExportTrace() {
+    QString path = QFileDialog::getSaveFileName(this, tr("导出追踪"),
+                                                QDir::homePath() + "/trace.json");
+    if (!path.isEmpty()) {
+        emit exportTrace(path);
+    }
+}
+
+void MenuBarWidget::onExportMetrics() {
+    QString path = QFileDialog::getSaveFileName(this, tr("导出运行指标"),
+                                                QDir::homePath() + "/metrics.prom");
+    if (!path.isEmpty()) {
+        emit exportMetrics(path);
+    }
+}
+
 void MenuBarWidget::onNewFolder() { emit newFolder(); }
 
 void MenuBarWidget::onOpenSettings() { emit openSettings(); }
@@ -18,11 +18,17 @@ class MenuBarWidget : public QMenuBar {
 signals:
     void runCode();
     void saveFile();
+    /** Save all the modified files */
+    void saveAllFiles();
     void openFolder(const QString &folderPath);
     /** Create a new file (at the root of the project) */
     void newFile();
     /** Create a new folder (at the root of the project) */
     void newFolder();
+    /** Find in the current file */
+    void findText();
+    /** Find and replace in the current file */
+    void replaceText();
     /** Open the settings */
     void openSettings();
     /** Login to OJ */
@@ -35,9 +41,18 @@ signals:
     void batchDownloadOJ();
     /** Submit the code to OJ */
     void submitOJ();
+    /** Export the keystroke latency histogram to the path */
+    void exportLatency(const QString &path);
+    /** Show the stalls of the GUI thread */
+    void showStalls();
+    /** Export the recorded trace to the path */
+    void exportTrace(const QString &path);
+    /** Export the metrics snapshot to the path */
+    void exportMetrics(const QString &path);
 
 private slots:
     void onSave();
+    void onSaveAll();
     void onOpenFolder();
     void onNewFile();
     void onNewFolder();
@@ -47,6 +62,13 @@ private slots:
     void onDownloadOJ();
     void onBatchDownloadOJ();
     void onSubmitOJ();
+    void onToggleLatencyOverlay();
+    void onExportLatency();
+    void onToggleOffline();
+    void onClearCache();
+    void onToggleTracing();
+    void onExportTrace();
+    void onExportMetrics();
 
 public slots:
     void onLogin(const QString& username) ;
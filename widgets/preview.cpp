@@ -8,10 +8,14 @@
 #include <QMessageBox>
 #include <QTextEdit>
 #include <QVBoxLayout>
+#include <algorithm>
+#include <optional>
 #include <utility>
 
 #include "../util/file.h"
+#include "../util/task.h"
 #include "../web/crawl.h"
+#include "../web/submission.h"
 #include "footer.h"
 
 class PreviewTextWidget : public QTextEdit {
@@ -19,6 +23,8 @@ class PreviewTextWidget : public QTextEdit {
 
     QString title;
     QUrl url;
+    bool loaded = false;
+    std::optional<OJSubmitForm> form;
     void setup() { setReadOnly(true); }
 
 public:
@@ -28,6 +34,11 @@ public:
     }
     QUrl &getUrl() { return url; }
     QString &getTitle() { return title; }
+    void setTitle(const QString &title) { this->title = title; }
+    bool isLoaded() const { return loaded; }
+    void setLoaded(bool loaded) { this->loaded = loaded; }
+    /** Fetched ahead by the prefetch, submit fetches it itself when it is not */
+    std::optional<OJSubmitForm> &getForm() { return form; }
 };
 
 class EmptyPreviewWidget : public QTextEdit {
@@ -43,6 +54,8 @@ public:
 };
 
 #define DEFAULT_LABEL "题目预览"
+// contest pages downloaded at once in the background, the current page does not wait for them
+#define PREFETCH_WINDOW 2
 
 OpenJudgePreviewWidget::OpenJudgePreviewWidget(QWidget *parent) : QWidget(parent), curIndex(0) {
     titleLabel = new QLabel(tr(DEFAULT_LABEL), this);
@@ -55,8 +68,13 @@ OpenJudgePreviewWidget::OpenJudgePreviewWidget(QWidget *parent) : QWidget(parent
 
     connect(this, &OpenJudgePreviewWidget::previewPagesReset, this, &OpenJudgePreviewWidget::reset);
     connect(this, &OpenJudgePreviewWidget::currentIndexChanged, this, &OpenJudgePreviewWidget::refresh);
-    connect(this, &OpenJudgePreviewWidget::submitFinished, this, &OpenJudgePreviewWidget::waitForResponse);
-    connect(this, &OpenJudgePreviewWidget::submitResponseReceived, this, &OpenJudgePreviewWidget::showSubmitResponse);
+    connect(&SubmissionTracker::instance(), &SubmissionTracker::verdictReceived, this,
+            &OpenJudgePreviewWidget::showSubmitResponse);
+    connect(&SubmissionTracker::instance(), &SubmissionTracker::failed, this,
+            [](const QString &title, const QString &error) {
+                FooterWidget::instance().notify(tr("%1：未能获取评测结果").arg(title), false,
+                                                error);
+            });
 }
 
 void OpenJudgePreviewWidget::setup() {
@@ -114,6 +132,14 @@ PreviewTextWidget *OpenJudgePreviewWidget::curPreview() const {
 }
 
 void OpenJudgePreviewWidget::clear() {
+    // the pages still prefetching finish into deleted pages, which they check
+    prefetchGeneration++;
+    prefetchQueue.clear();
+    prefetchErrors.clear();
+    prefetchRunning = 0;
+    prefetchDone = 0;
+    prefetchTask.finish();
+
     // remove all items in textLayout
     while (textLayout->count() > 0) {
         auto item = textLayout->takeAt(0);
@@ -125,11 +151,15 @@ void OpenJudgePreviewWidget::clear() {
     emit previewPagesReset();
 }
 
-QCoro::Task<std::expected<OJProblem, QString>> OpenJudgePreviewWidget::downloadAndParse(QUrl url) {
-    auto content = co_await Crawler::instance().get(url);
+QCoro::Task<std::expected<OJProblem, QString>>
+OpenJudgePreviewWidget::downloadAndParse(QUrl url, CancelToken token, TaskPriority priority) {
+    auto content = co_await Crawler::instance().get(url, priority, true);
     if (!content.has_value()) {
         co_return std::unexpected(tr("下载失败：%1").arg(content.error()));
     }
+    if (token.isCanceled()) {
+        co_return std::unexpected(tr("已取消"));
+    }
     auto parsed = co_await OJParser::parseProblem(content.value());
     if (!parsed.has_value()) {
         co_return std::unexpected(tr("解析失败：%1").arg(parsed.error()));
@@ -139,6 +169,101 @@ QCoro::Task<std::expected<OJProblem, QString>> OpenJudgePreviewWidget::downloadA
     co_return parsed.value();
 }
 
+QCoro::Task<std::expected<OJSubmitForm, QString>>
+OpenJudgePreviewWidget::downloadSubmitForm(QUrl problemUrl, TaskPriority priority) {
+    QUrl submitUrl = problemUrl.url() + "/submit";
+    auto content = co_await Crawler::instance().get(submitUrl, priority);
+    if (!content.has_value()) {
+        // The res should be ok here, unless the website changed
+        co_return std::unexpected(content.error());
+    }
+    co_return co_await OJParser::parseProblemSubmitForm(content.value());
+}
+
+QCoro::Task<QString> OpenJudgePreviewWidget::fillPreview(QPointer<PreviewTextWidget> preview,
+                                                         CancelToken token,
+                                                         TaskPriority priority) {
+    QUrl url = preview->getUrl();
+    auto problem = co_await downloadAndParse(url, token, priority);
+    if (!preview) {
+        co_return QString(); // cleared by another download meanwhile
+    }
+    if (!problem.has_value()) {
+        preview->setText(problem.error());
+        co_return tr("处理试题 %1 时出错：%2").arg(url.toString(), problem.error());
+    }
+    preview->setTitle(problem->title);
+    preview->setHtml(problem->content);
+    preview->setLoaded(true);
+    emit currentIndexChanged(); // the title shown may be this one
+    co_return QString();
+}
+
+void OpenJudgePreviewWidget::pumpPrefetch() {
+    if (prefetchTask.isCanceled()) {
+        prefetchQueue.clear();
+    }
+    prefetchQueue.removeIf([](const auto &page) { return page.isNull(); });
+
+    // the page shown is wanted now, it does not wait for the window
+    auto *current = curPreview();
+    if (current && !current->isLoaded() && prefetchQueue.removeOne(current)) {
+        prefetchPage(current, TaskPriority::High);
+    }
+
+    // the problems before the submit forms but the current one, the nearest first, the next page
+    // before the last one
+    auto rank = [this](const QPointer<PreviewTextWidget> &page) {
+        int distance = textLayout->indexOf(page) - curIndex;
+        return std::pair(page->isLoaded() && distance != 0,
+                         distance >= 0 ? 2 * distance : 1 - 2 * distance);
+    };
+    while (prefetchRunning < PREFETCH_WINDOW && !prefetchQueue.isEmpty()) {
+        auto next = std::ranges::min_element(prefetchQueue, {}, rank);
+        QPointer<PreviewTextWidget> page = *next;
+        prefetchQueue.erase(next);
+        prefetchPage(page, TaskPriority::Low);
+    }
+
+    if (prefetchRunning == 0 && prefetchQueue.isEmpty()) {
+        prefetchTask.finish();
+        if (!prefetchErrors.isEmpty()) {
+            warning(prefetchErrors.join('\n'));
+            prefetchErrors.clear();
+        }
+    }
+}
+
+QCoro::Task<> OpenJudgePreviewWidget::prefetchPage(QPointer<PreviewTextWidget> preview,
+                                                   TaskPriority priority) {
+    quint64 generation = prefetchGeneration;
+    prefetchRunning++;
+    if (!preview->isLoaded()) {
+        auto error = co_await fillPreview(preview, prefetchTask.token(), priority);
+        if (generation != prefetchGeneration) {
+            co_return; // cleared meanwhile
+        }
+        prefetchTask.update(++prefetchDone);
+        if (!error.isEmpty() && !prefetchTask.isCanceled()) {
+            prefetchErrors.append(error);
+        } else if (preview && Crawler::instance().hasLogin()) {
+            prefetchQueue.append(preview); // its submit form, after the other problems
+        }
+    } else {
+        prefetchTask.setText(tr("正在获取提交表单"));
+        // a form that failed is left to submit, which reports its error
+        auto form = co_await downloadSubmitForm(preview->getUrl(), priority);
+        if (generation != prefetchGeneration) {
+            co_return;
+        }
+        if (preview && form.has_value()) {
+            preview->getForm() = std::move(form.value());
+        }
+    }
+    prefetchRunning--;
+    pumpPrefetch();
+}
+
 class LoginDialog : public QDialog {
     Q_OBJECT
 
@@ -206,9 +331,12 @@ QCoro::Task<> OpenJudgePreviewWidget::loginOJ() {
     }
     Configs::instance().set("email", dialog.rememberMe() ? email : "");
 
-    auto task = FooterWidget::newTask(tr("正在登入"));
-    task.wait();
+    auto task = co_await TaskManager::instance().start(tr("正在登入"), TaskResource::None,
+                                                       TaskPriority::High);
     auto res = co_await Crawler::instance().login(email, password);
+    if (task.isCanceled()) {
+        co_return;
+    }
     task.finish();
 
     if (!res.has_value()) {
@@ -257,71 +385,62 @@ QCoro::Task<> OpenJudgePreviewWidget::submit(QString code) {
         co_await loginOJ();
         co_return;
     }
-    QUrl submitUrl = curPreview()->getUrl().url() + "/submit";
-    auto task = FooterWidget::newTask(tr("正在提交题目"));
-    task.wait();
-    auto submitRes = co_await Crawler::instance().get(submitUrl);
-    if (!submitRes.has_value()) {
-        // The res should be ok here, unless the website changed
-        warning(submitRes.error());
+    QPointer<PreviewTextWidget> preview = curPreview();
+    QUrl problemUrl = preview->getUrl();
+    QString title = preview->getTitle();
+    TaskHandle task;
+    OJSubmitForm form;
+    if (preview->getForm().has_value()) {
+        form = preview->getForm().value();
+    } else {
+        // not prefetched yet
+        task = co_await TaskManager::instance().start(tr("正在提交题目"), TaskResource::None,
+                                                      TaskPriority::High);
+        auto formRes = co_await downloadSubmitForm(problemUrl, TaskPriority::High);
+        if (task.isCanceled()) {
+            co_return;
+        }
         task.finish();
-        co_return;
-    }
-    task.wait(tr("正在检查提交表单项"));
-    auto formRes = co_await OJParser::parseProblemSubmitForm(submitRes.value());
-    task.finish();
-    if (!formRes.has_value()) {
-        warning(formRes.error());
-        co_return;
+        if (!formRes.has_value()) {
+            warning(formRes.error());
+            co_return;
+        }
+        form = formRes.value();
+        if (preview) {
+            preview->getForm() = form;
+        }
     }
-    auto form = formRes.value();
     auto dialog = SubmitFromDialog(form, this);
     if (dialog.exec() != QDialog::Accepted) {
         co_return;
     }
 
-    task = FooterWidget::newTask(tr("正在提交表单"));
-    task.wait();
-    OJSubmitForm newForm = {form.contestId, form.problemNumber, {}, code, dialog.getLanguage(), curPreview()->getUrl()};
+    task = co_await TaskManager::instance().start(tr("正在提交表单"), TaskResource::None,
+                                                  TaskPriority::High);
+    OJSubmitForm newForm = {form.contestId, form.problemNumber, {}, code, dialog.getLanguage(), problemUrl};
     auto res = co_await Crawler::instance().submit(newForm);
-    task.finish();
-
-    if (!res.has_value()) {
-        warning(res.error());
+    if (task.isCanceled()) {
         co_return;
     }
-    emit submitFinished(std::move(res.value()));
-    co_return;
-}
+    task.finish();
 
-QCoro::Task<> OpenJudgePreviewWidget::waitForResponse(QUrl responseUrl) {
-    auto task = FooterWidget::newTask("正在等待提交结果");
-    task.wait();
-    auto res = co_await Crawler::instance().get(responseUrl);
     if (!res.has_value()) {
-        warning(tr("等待提交结果时出现错误: %1").arg(res.error()));
-        task.finish();
-        co_return;
-    }
-    auto response = co_await OJParser::parseProblemSubmitResponse(res.value());
-    if (!response.has_value()) {
-        warning(response.error());
-        task.finish();
+        warning(res.error());
         co_return;
     }
-    emit submitResponseReceived(std::move(response.value()), std::move(responseUrl));
-    task.finish();
+    // polled in the background, the verdict comes back as a notification
+    SubmissionTracker::instance().track(res.value(), title);
     co_return;
 }
 
-void OpenJudgePreviewWidget::showSubmitResponse(const OJSubmitResponse &response, QUrl source) {
+void OpenJudgePreviewWidget::showSubmitResponse(const QString &title,
+                                                const OJSubmitResponse &response) {
     QString text;
+    QString detail;
     bool ok = false;
     switch (response.result) {
         case OJSubmitResponse::W:
-            // retry to wait for the result;
-            emit submitFinished(std::move(source));
-            return;
+            return; // the tracker only reports the judged ones
         case OJSubmitResponse::AC:
             ok = true;
             text = tr("您 AC 了！太您了！");
@@ -330,7 +449,8 @@ void OpenJudgePreviewWidget::showSubmitResponse(const OJSubmitResponse &response
             text = tr("喜报：您 WA 了！");
             break;
         case OJSubmitResponse::CE:
-            text = tr("CE... 提交前能不能先看看代码跑得起来不？\n%1").arg(response.message);
+            text = tr("CE... 提交前能不能先看看代码跑得起来不？");
+            detail = response.message;
             break;
         case OJSubmitResponse::RE:
             text = tr("您 RE 了！但愿不是段错误...");
@@ -349,11 +469,7 @@ void OpenJudgePreviewWidget::showSubmitResponse(const OJSubmitResponse &response
             break;
     }
 
-    if (ok) {
-        QMessageBox::information(this, "通过！", text);
-    } else {
-        QMessageBox::warning(this, "失败！", text);
-    }
+    FooterWidget::instance().notify(QString("%1：%2").arg(title, text), ok, detail);
 }
 
 QCoro::Task<> OpenJudgePreviewWidget::downloadOJ() {
@@ -368,7 +484,13 @@ QCoro::Task<> OpenJudgePreviewWidget::downloadOJ() {
         co_return;
     };
 
-    auto res = co_await downloadAndParse(url);
+    auto task = co_await TaskManager::instance().start(tr("正在下载题目"), TaskResource::None,
+                                                       TaskPriority::High);
+    auto res = co_await downloadAndParse(url, {}, TaskPriority::High);
+    if (task.isCanceled()) {
+        co_return;
+    }
+    task.finish();
     if (!res.has_value()) {
         warning(res.error());
         co_return;
@@ -377,8 +499,13 @@ QCoro::Task<> OpenJudgePreviewWidget::downloadOJ() {
     clear();
     auto preview = new PreviewTextWidget(url, res->title, this);
     preview->setHtml(res.value().content);
+    preview->setLoaded(true);
     textLayout->addWidget(preview);
     emit previewPagesReset();
+    if (Crawler::instance().hasLogin()) {
+        prefetchQueue.append(preview); // its submit form
+        pumpPrefetch();
+    }
     co_return;
 }
 
@@ -398,14 +525,23 @@ QCoro::Task<> OpenJudgePreviewWidget::batchDownloadOJ() {
     }
 
     QUrl match(matchUrl);
-    auto content = co_await Crawler::instance().get(match);
+    auto task = co_await TaskManager::instance().start(tr("正在下载比赛"));
+    auto content = co_await Crawler::instance().get(match, TaskPriority::Normal, true);
+    if (task.isCanceled()) {
+        co_return;
+    }
     if (!content.has_value()) {
+        task.finish();
         warning(tr("下载比赛失败：%1").arg(content.error()));
         co_return;
     }
 
     auto urls = co_await OJParser::parseMatch(content.value());
+    if (task.isCanceled()) {
+        co_return;
+    }
     if (!urls.has_value()) {
+        task.finish();
         warning(tr("解析比赛失败：%1").arg(urls.error()));
         co_return;
     }
@@ -415,26 +551,23 @@ QCoro::Task<> OpenJudgePreviewWidget::batchDownloadOJ() {
     auto problemUrls = urls.value().problemUrls;
 
     // show a progress bar
-    ProgressBarTask task = FooterWidget::newTask("正在下载并解析题目", static_cast<int>(problemUrls.length()));
+    task.setMaximum(static_cast<int>(problemUrls.length()));
+    task.setText(tr("正在下载并解析题目"));
 
+    // A placeholder page per problem in the contest order, filled in the background around the
+    // page shown, which follows the user as they turn the pages
     for (int i = 0; i < problemUrls.length(); i++) {
         // These urls are relative url in the website
         auto url = match.resolved(problemUrls[i]);
-        task.update(i);
-
-        auto problem = co_await downloadAndParse(url);
-        if (problem.has_value()) {
-            auto preview = new PreviewTextWidget(url, problem->title, this);
-            preview->setHtml(problem.value().content);
-            preview->setVisible(false);
-            textLayout->addWidget(preview);
-        } else {
-            warning(tr("处理试题 %1 时出错:\n").arg(url.toString()) + problem.error());
-        }
+        auto preview = new PreviewTextWidget(url, tr("第 %1 题").arg(i + 1), this);
+        preview->setText(tr("正在下载 %1 ……").arg(url.toString()));
+        preview->setVisible(false);
+        textLayout->addWidget(preview);
+        prefetchQueue.append(preview);
     }
-    task.finish();
-
+    prefetchTask = std::move(task);
     emit previewPagesReset();
+    pumpPrefetch();
     co_return;
 }
 
@@ -443,6 +576,7 @@ void OpenJudgePreviewWidget::incrementIndex() {
         curIndex++;
     }
     emit currentIndexChanged();
+    pumpPrefetch();
 }
 
 void OpenJudgePreviewWidget::decrementIndex() {
@@ -450,6 +584,7 @@ void OpenJudgePreviewWidget::decrementIndex() {
         curIndex--;
     }
     emit currentIndexChanged();
+    pumpPrefetch();
 }
 
 #include "preview.moc"
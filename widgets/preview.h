@@ -3,10 +3,13 @@
 
 #include <QLabel>
 #include <QLayout>
+#include <QPointer>
 #include <QTextEdit>
 #include <expected>
 #include <qcorotask.h>
 
+#include "../util/task.h"
+#include "../util/worker.h"
 #include "../web/parse.h"
 #include "icon.h"
 
@@ -23,18 +26,35 @@ class OpenJudgePreviewWidget : public QWidget {
     QLayout *textLayout;
     int curIndex;
 
+    /** The pages of the contest still to download, or to fetch the submit form for */
+    QList<QPointer<PreviewTextWidget>> prefetchQueue;
+    TaskHandle prefetchTask;
+    QStringList prefetchErrors;
+    int prefetchRunning = 0;
+    int prefetchDone = 0;
+    /** Changed by clear, a prefetch of the pages before it is forgotten */
+    quint64 prefetchGeneration = 0;
+
     void setup();
     void reset();
     void refresh() const;
     PreviewTextWidget *curPreview() const;
     void warning(const QString &message);
-    static QCoro::Task<std::expected<OJProblem, QString>> downloadAndParse(QUrl url);
+    static QCoro::Task<std::expected<OJProblem, QString>>
+    downloadAndParse(QUrl url, CancelToken token = {},
+                     TaskPriority priority = TaskPriority::Normal);
+    static QCoro::Task<std::expected<OJSubmitForm, QString>>
+    downloadSubmitForm(QUrl problemUrl, TaskPriority priority);
+    /** Download the problem of a placeholder page into it, the error if it failed */
+    QCoro::Task<QString> fillPreview(QPointer<PreviewTextWidget> preview, CancelToken token,
+                                     TaskPriority priority);
+    /** Start the waiting pages nearest to the current one, the current one at once */
+    void pumpPrefetch();
+    QCoro::Task<> prefetchPage(QPointer<PreviewTextWidget> preview, TaskPriority priority);
 
 signals:
     void previewPagesReset();
     void currentIndexChanged();
-    void submitFinished(QUrl redirectUrl);
-    void submitResponseReceived(OJSubmitResponse response, QUrl source);
     void loginAs(const QString &username);
 
 private slots:
@@ -44,8 +64,7 @@ private slots:
 public slots:
     QCoro::Task<> loginOJ();
     QCoro::Task<> submit(QString code);
-    QCoro::Task<> waitForResponse(QUrl responseUrl);
-    void showSubmitResponse(const OJSubmitResponse& response, QUrl source);
+    void showSubmitResponse(const QString &title, const OJSubmitResponse &response);
     QCoro::Task<> downloadOJ();
     QCoro::Task<> batchDownloadOJ();
 
@@ -0,0 +1,135 @@
+#include "projectSearch.h"
+
+#include <QDir>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QVBoxLayout>
+
+#include "../util/file.h"
+
+#define PATH_ROLE Qt::UserRole
+#define LINE_ROLE (Qt::UserRole + 1)
+#define COLUMN_ROLE (Qt::UserRole + 2)
+#define LENGTH_ROLE (Qt::UserRole + 3)
+
+ProjectSearchWidget::ProjectSearchWidget(QWidget *parent) : QWidget(parent), matchCount(0) {
+    search = new ProjectSearch(this);
+    headerLabel = new QLabel(tr("搜索"), this);
+    queryEdit = new QLineEdit(this);
+    regexBox = new QCheckBox(tr("正则"), this);
+    caseBox = new QCheckBox(tr("区分大小写"), this);
+    stopBtn = new QPushButton(tr("停止"), this);
+    statusLabel = new QLabel(this);
+    resultTree = new QTreeWidget(this);
+    setup();
+
+    connect(queryEdit, &QLineEdit::returnPressed, this, &ProjectSearchWidget::startSearch);
+    connect(regexBox, &QCheckBox::toggled, this, &ProjectSearchWidget::startSearch);
+    connect(caseBox, &QCheckBox::toggled, this, &ProjectSearchWidget::startSearch);
+    connect(stopBtn, &QPushButton::clicked, this, &ProjectSearchWidget::stopSearch);
+    connect(search, &ProjectSearch::matchesFound, this, &ProjectSearchWidget::onMatchesFound);
+    connect(search, &ProjectSearch::searchFinished, this, &ProjectSearchWidget::onSearchFinished);
+    connect(resultTree, &QTreeWidget::itemActivated, this,
+            &ProjectSearchWidget::onItemActivated);
+    connect(resultTree, &QTreeWidget::itemClicked, this, &ProjectSearchWidget::onItemActivated);
+}
+
+void ProjectSearchWidget::setup() {
+    headerLabel->setObjectName("headerLabel");
+    queryEdit->setPlaceholderText(tr("在项目中搜索（回车开始）"));
+    stopBtn->setVisible(false);
+    statusLabel->setObjectName("statusLabel");
+    resultTree->header()->hide();
+    resultTree->setUniformRowHeights(true);
+
+    auto *options = new QHBoxLayout();
+    options->setContentsMargins(8, 0, 8, 0);
+    options->addWidget(regexBox);
+    options->addWidget(caseBox);
+    options->addStretch(1);
+    options->addWidget(stopBtn);
+
+    auto *mainLayout = new QVBoxLayout(this);
+    mainLayout->setContentsMargins(0, 0, 0, 0);
+    mainLayout->setSpacing(4);
+    mainLayout->addWidget(headerLabel);
+    mainLayout->addWidget(queryEdit);
+    mainLayout->addLayout(options);
+    mainLayout->addWidget(statusLabel);
+    mainLayout->addWidget(resultTree);
+    setLayout(mainLayout);
+
+    // shares the look of the file tree
+    setStyleSheet(loadText("qss/fileTree.css"));
+}
+
+void ProjectSearchWidget::setRoot(const QString &root) {
+    stopSearch();
+    this->root = root;
+    resultTree->clear();
+    fileItems.clear();
+    statusLabel->clear();
+}
+
+void ProjectSearchWidget::startSearch() {
+    SearchQuery query{queryEdit->text(), regexBox->isChecked(), caseBox->isChecked()};
+    if (query.isEmpty() || root.isEmpty()) {
+        return;
+    }
+    if (query.regex && !query.expression().isValid()) {
+        statusLabel->setText(tr("正则错误: %1").arg(query.expression().errorString()));
+        return;
+    }
+    resultTree->clear();
+    fileItems.clear();
+    matchCount = 0;
+    statusLabel->setText(tr("搜索中..."));
+    stopBtn->setVisible(true);
+    search->start(root, query);
+}
+
+void ProjectSearchWidget::stopSearch() {
+    if (!search->isRunning()) {
+        return;
+    }
+    search->cancel();
+    stopBtn->setVisible(false);
+    statusLabel->setText(tr("已停止，找到 %1 处").arg(matchCount));
+}
+
+void ProjectSearchWidget::onMatchesFound(const QList<FileMatch> &matches) {
+    QDir rootDir(root);
+    for (const auto &match: matches) {
+        auto *&fileItem = fileItems[match.path];
+        if (!fileItem) {
+            fileItem = new QTreeWidgetItem(resultTree, {rootDir.relativeFilePath(match.path)});
+            fileItem->setToolTip(0, match.path);
+            fileItem->setExpanded(true);
+        }
+        auto *item = new QTreeWidgetItem(
+                fileItem, {QString("%1: %2").arg(match.line + 1).arg(match.preview.trimmed())});
+        item->setData(0, PATH_ROLE, match.path);
+        item->setData(0, LINE_ROLE, match.line);
+        item->setData(0, COLUMN_ROLE, match.column);
+        item->setData(0, LENGTH_ROLE, match.length);
+    }
+    matchCount += static_cast<int>(matches.size());
+    statusLabel->setText(tr("搜索中... 已找到 %1 处").arg(matchCount));
+}
+
+void ProjectSearchWidget::onSearchFinished(int files, int matches, bool truncated) {
+    stopBtn->setVisible(false);
+    QString text = tr("在 %1 个文件中找到 %2 处").arg(files).arg(matches);
+    if (truncated) {
+        text += tr("（结果过多，已截断）");
+    }
+    statusLabel->setText(text);
+}
+
+void ProjectSearchWidget::onItemActivated(const QTreeWidgetItem *item) {
+    if (!item || !item->parent()) {
+        return; // a file item
+    }
+    emit openMatch(item->data(0, PATH_ROLE).toString(), item->data(0, LINE_ROLE).toInt(),
+                   item->data(0, COLUMN_ROLE).toInt(), item->data(0, LENGTH_ROLE).toInt());
+}
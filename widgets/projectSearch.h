@@ -0,0 +1,47 @@
+#ifndef PROJECT_SEARCH_H
+#define PROJECT_SEARCH_H
+
+#include <QCheckBox>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QTreeWidget>
+
+#include "../ide/search.h"
+
+/** The "search in project" panel, showing the matches grouped by file */
+class ProjectSearchWidget : public QWidget {
+    Q_OBJECT
+
+    QString root;
+    ProjectSearch *search;
+    QLabel *headerLabel;
+    QLineEdit *queryEdit;
+    QCheckBox *regexBox;
+    QCheckBox *caseBox;
+    QPushButton *stopBtn;
+    QLabel *statusLabel;
+    QTreeWidget *resultTree;
+    /** Items of the files with matches, by path */
+    QHash<QString, QTreeWidgetItem *> fileItems;
+    int matchCount;
+
+    void setup();
+
+private slots:
+    void startSearch();
+    void stopSearch();
+    void onMatchesFound(const QList<FileMatch> &matches);
+    void onSearchFinished(int files, int matches, bool truncated);
+    void onItemActivated(const QTreeWidgetItem *item);
+
+signals:
+    /** The user wants to see the match */
+    void openMatch(const QString &path, int line, int column, int length);
+
+public:
+    explicit ProjectSearchWidget(QWidget *parent = nullptr);
+    void setRoot(const QString &root);
+};
+
+#endif // PROJECT_SEARCH_H
@@ -6,7 +6,11 @@
 #include <QSplitter>
 
 #include "../util/file.h"
+#include "../util/latency.h"
+#include "../util/metrics.h"
+#include "../util/trace.h"
 #include "aiAssistant.h"
+#include "diagnostics.h"
 #include "ojPersonal.h"
 #include "preview.h"
 #include "setting.h"
@@ -16,6 +20,7 @@ IDEMainWindow::IDEMainWindow(QWidget *parent) : QMainWindow(parent) {
     leftNav = new LeftIconNavigateWidget(this);
     rightNav = new RightIconNavigateWidget(this);
     fileTree = new FileTreeWidget(this);
+    projectSearch = new ProjectSearchWidget(this);
     terminal = new TerminalWidget(this);
     codeTab = new CodeTabWidget(this);
     menuBar = new MenuBarWidget(this);
@@ -24,6 +29,7 @@ IDEMainWindow::IDEMainWindow(QWidget *parent) : QMainWindow(parent) {
     footer = &FooterWidget::instance();
 
     terminal->setVisible(false);
+    projectSearch->setVisible(false);
     ojPreview->setVisible(false);
     aiAssistant->setVisible(false);
 
@@ -44,14 +50,16 @@ void IDEMainWindow::setup() {
 
     auto *hSplitter = new QSplitter(Qt::Horizontal, this);
     hSplitter->addWidget(fileTree);
+    hSplitter->addWidget(projectSearch);
     hSplitter->addWidget(codeTab);
     hSplitter->addWidget(ojPreview);
     hSplitter->addWidget(aiAssistant);
 
     hSplitter->setStretchFactor(0, 2);
-    hSplitter->setStretchFactor(1, 4);
-    hSplitter->setStretchFactor(2, 2);
+    hSplitter->setStretchFactor(1, 2);
+    hSplitter->setStretchFactor(2, 4);
     hSplitter->setStretchFactor(3, 2);
+    hSplitter->setStretchFactor(4, 2);
 
     auto *vSplitter = new QSplitter(Qt::Vertical, this);
     vSplitter->addWidget(hSplitter);
@@ -77,6 +85,8 @@ void IDEMainWindow::connectSignals() {
     // Icon navigate
     connect(leftNav, &LeftIconNavigateWidget::toggleFileTree, fileTree,
             &FileTreeWidget::setVisible);
+    connect(leftNav, &LeftIconNavigateWidget::toggleSearch, projectSearch,
+            &ProjectSearchWidget::setVisible);
     connect(leftNav, &LeftIconNavigateWidget::toggleTerminal, terminal,
             &TerminalWidget::setVisible);
     connect(rightNav, &RightIconNavigateWidget::loginOJ, ojPreview,
@@ -102,13 +112,24 @@ void IDEMainWindow::connectSignals() {
     connect(menuBar, &MenuBarWidget::newFolder, fileTree,
             [this] { fileTree->createNewFolder(ide->curProject().getRoot()); });
     connect(menuBar, &MenuBarWidget::saveFile, codeTab, &CodeTabWidget::save);
+    connect(menuBar, &MenuBarWidget::saveAllFiles, codeTab, &CodeTabWidget::saveAll);
     connect(menuBar, &MenuBarWidget::openFolder, this, &IDEMainWindow::openFolder);
     connect(fileTree, &FileTreeWidget::operateFile, codeTab, &CodeTabWidget::handleFileOperation);
+    connect(projectSearch, &ProjectSearchWidget::openMatch, codeTab,
+            [this](const QString &path, int line, int column, int length) {
+                codeTab->handleFileOperation(path, OPEN);
+                auto *edit = codeTab->curEdit();
+                if (edit && edit->getFile().filePath() == path) {
+                    edit->cursorMoveTo(line, column, line, column + length);
+                }
+            });
 
     // Running
     connect(menuBar, &MenuBarWidget::runCode, this, &IDEMainWindow::runCurrentCode);
 
     // Edit
+    connect(menuBar, &MenuBarWidget::findText, codeTab, [this] { codeTab->showFindBar(false); });
+    connect(menuBar, &MenuBarWidget::replaceText, codeTab, [this] { codeTab->showFindBar(true); });
     connect(menuBar, &MenuBarWidget::openSettings, this, &IDEMainWindow::openSettings);
 
     // OJ
@@ -125,6 +146,24 @@ void IDEMainWindow::connectSignals() {
 
     // OJ set_info
     connect(menuBar, &MenuBarWidget::personalizeOJ, this, &IDEMainWindow::openPersonalSettings);
+
+    // Diagnostics
+    connect(menuBar, &MenuBarWidget::exportLatency, this, [this](const QString &path) {
+        if (!LatencyProbe::instance().exportTo(path)) {
+            QMessageBox::warning(this, tr("错误"), tr("无法写入 %1").arg(path));
+        }
+    });
+    connect(menuBar, &MenuBarWidget::showStalls, this, &IDEMainWindow::openDiagnostics);
+    connect(menuBar, &MenuBarWidget::exportTrace, this, [this](const QString &path) {
+        if (!Tracer::instance().exportTo(path)) {
+            QMessageBox::warning(this, tr("错误"), tr("无法写入 %1").arg(path));
+        }
+    });
+    connect(menuBar, &MenuBarWidget::exportMetrics, this, [this](const QString &path) {
+        if (!Metrics::instance().exportTo(path)) {
+            QMessageBox::warning(this, tr("错误"), tr("无法写入 %1").arg(path));
+        }
+    });
 }
 
 void IDEMainWindow::openFolder(const QString &folder) const {
@@ -133,6 +172,7 @@ void IDEMainWindow::openFolder(const QString &folder) const {
     ide->setProject(project);
     codeTab->setProject(&ide->curProject());
     fileTree->setRoot(project.getRoot());
+    projectSearch->setRoot(project.getRoot());
     ojPreview->clear();
     terminal->setProject(&ide->curProject());
 }
@@ -142,7 +182,7 @@ void IDEMainWindow::openSettings() {
     dlg.exec();
 }
 
-void IDEMainWindow::runCurrentCode() const {
+QCoro::Task<> IDEMainWindow::runCurrentCode() const {
     // awake the terminal
     terminal->setVisible(true);
 
@@ -150,14 +190,17 @@ void IDEMainWindow::runCurrentCode() const {
 
     if (!file.isValid()) {
         QMessageBox::warning(menuBar, tr("错误"), tr("不存在的文件或非法文件"));
-        return;
+        co_return;
     }
     if (file.language() == Language::UNKNOWN) {
         QMessageBox::warning(menuBar, tr("错误"), tr("不支持运行的文件类型"));
-        return;
+        co_return;
     }
 
-    codeTab->save(); // save the current file before running
+    // save the current file before running
+    if (!co_await codeTab->save()) {
+        co_return;
+    }
     terminal->runCmd(Command::runFile(file));
 }
 
@@ -168,7 +211,7 @@ void IDEMainWindow::submitCurrentCode() const {
         return;
     }
     // get the text on the current edit
-    QString code = edit->toPlainText();
+    QString code = edit->snapshot().text();
     if (code.isEmpty()) {
         QMessageBox::warning(menuBar, tr("错误"), tr("代码不能为空"));
         return;
@@ -179,4 +222,9 @@ void IDEMainWindow::submitCurrentCode() const {
 void IDEMainWindow::openPersonalSettings() {
     PersonalSettingsDialog dlg(this);
     dlg.exec();
+}
+
+void IDEMainWindow::openDiagnostics() {
+    DiagnosticsDialog dlg(this);
+    dlg.exec();
 }
\ No newline at end of file
@@ -10,6 +10,7 @@
 #include "iconNav.h"
 #include "menu.h"
 #include "preview.h"
+#include "projectSearch.h"
 #include "terminal.h"
 #include "aiAssistant.h"
 
@@ -21,6 +22,7 @@ class IDEMainWindow : public QMainWindow {
     LeftIconNavigateWidget *leftNav;
     RightIconNavigateWidget *rightNav;
     FileTreeWidget *fileTree;
+    ProjectSearchWidget *projectSearch;
     TerminalWidget *terminal;
     CodeTabWidget *codeTab;
     MenuBarWidget *menuBar;
@@ -37,9 +39,10 @@ public:
 public slots:
     void openFolder(const QString &folder) const;
     void openSettings();
-    void runCurrentCode() const;
+    QCoro::Task<> runCurrentCode() const;
     void submitCurrentCode() const;
     void openPersonalSettings();
+    void openDiagnostics();
 };
 
 